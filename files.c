@@ -0,0 +1,104 @@
+#define _POSIX_C_SOURCE 200809L
+#include "files.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int map_file(char* path, char** data, size_t* size){
+	*data = NULL;
+	*size = 0;
+	int fd = open(path, O_RDONLY);
+	if(fd < 0){
+		fprintf(stderr, "[ERR] Failed to open %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	struct stat info;
+	if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)){
+		fprintf(stderr, "[ERR] %s is not a regular file\n", path);
+		close(fd);
+		return 1;
+	}
+	if(info.st_size == 0){
+		close(fd);
+		return 0;
+	}
+	void* mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// the mapping keeps its own reference to the file
+	close(fd);
+	if(mapped == MAP_FAILED){
+		fprintf(stderr, "[ERR] Failed to map %s: %s\n", path, strerror(errno));
+		return 1;
+	}
+	// it gets read front to back far more often than not
+	posix_madvise(mapped, info.st_size, POSIX_MADV_SEQUENTIAL);
+	mem_track_mapping(mapped, info.st_size);
+	*data = mapped;
+	*size = info.st_size;
+	return 0;
+}
+
+void unmap_file(char* data, size_t size){
+	if(data != NULL && size > 0){
+		mem_untrack_mapping(data);
+		munmap(data, size);
+	}
+}
+
+Writer_Table new_writer_table(void){
+	Writer_Table table = {
+		.writers = mem_alloc(4*sizeof(File_Writer)),
+		.count = 0,
+		.capacity = 4,
+	};
+	return table;
+}
+
+FILE* open_writer(Writer_Table* table, char* path){
+	for(size_t i = 0; i < table->count; i++){
+		if(strcmp(table->writers[i].path, path) == 0){
+			return table->writers[i].file;
+		}
+	}
+
+	// everything it needs is allocated before the file is opened, so a refused allocation
+	// never leaves an open file that nothing points to
+	if(table->count >= table->capacity){
+		table->writers = mem_realloc(table->writers, 2*table->capacity*sizeof(File_Writer));
+		table->capacity *= 2;
+	}
+	File_Writer writer = {
+		.path = mem_alloc(strlen(path)+1),
+		.buffer = mem_alloc(WRITER_BUFFER_SIZE),
+	};
+	strcpy(writer.path, path);
+	writer.file = fopen(path, "w");
+	if(writer.file == NULL){
+		fprintf(stderr, "[ERR] Failed to open %s for writing: %s\n", path, strerror(errno));
+		mem_free(writer.buffer);
+		mem_free(writer.path);
+		return NULL;
+	}
+	setvbuf(writer.file, writer.buffer, _IOFBF, WRITER_BUFFER_SIZE);
+
+	table->writers[table->count] = writer;
+	table->count++;
+	return writer.file;
+}
+
+void close_writers(Writer_Table* table){
+	for(size_t i = 0; i < table->count; i++){
+		if(fclose(table->writers[i].file) != 0){
+			fprintf(stderr, "[ERR] Failed to finish writing %s: %s\n", table->writers[i].path, strerror(errno));
+		}
+		mem_free(table->writers[i].buffer);
+		mem_free(table->writers[i].path);
+	}
+	mem_free(table->writers);
+	table->writers = NULL;
+	table->count = 0;
+}
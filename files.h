@@ -0,0 +1,31 @@
+#ifndef FILES_H
+#define FILES_H
+#include <stddef.h>
+#include <stdio.h>
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+
+// maps the whole file read-only, returns 1 if it can't be opened
+// an empty file gives data NULL and size 0 since there is nothing to map
+int map_file(char* path, char** data, size_t* size);
+void unmap_file(char* data, size_t size);
+
+// files written with `write` stay open (with a big buffer) until the program ends
+typedef struct {
+	char* path;
+	FILE* file;
+	char* buffer;
+} File_Writer;
+
+typedef struct {
+	File_Writer* writers;
+	size_t count;
+	size_t capacity;
+} Writer_Table;
+
+Writer_Table new_writer_table(void);
+// the first write to a path in a run truncates it, later ones add onto the end, NULL on failure
+FILE* open_writer(Writer_Table* table, char* path);
+void close_writers(Writer_Table* table);
+
+#endif // FILES_H
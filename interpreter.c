@@ -1,13 +1,41 @@
+#define _POSIX_C_SOURCE 200809L
 #include "interpreter.h"
+#include "memory.h"
 #include "lexer.h"
 #include "parser.h"
+#include "rope.h"
+#include "jit.h"
+#include "shell.h"
+#include "records.h"
+#include "files.h"
+#include "trace.h"
+#include "std.h"
+#include "pool.h"
+#include "snapshot.h"
+#include "optimize.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+// every runtime error also dumps the trace of what ran up to it (once per run)
+#define RUN_ERROR(...) do { fprintf(stderr, __VA_ARGS__); trace_error(); } while(0)
+
+int jit_enabled = 0;
+int jit_verify = 0;
+size_t max_frames = DEFAULT_MAX_FRAMES;
+// set by -n so counters like `var total (total + f2)` work without setting them up first
+int unset_vars_are_zero = 0;
+// the program being run, every Expr is an index into its nodes
+Parser* ast = NULL;
+// the jit code of the run being stepped, set with ast
+Jit_Cache* jit_cache = NULL;
+// set in debug mode, every statement list the optimizer changes gets printed again
+int dump_optimized = 0;
+
+// room for the digits, a minus sign and the null terminator
 int get_digits(int value){
-	int res = 1;
-	while(value > 0){
+	int res = value < 0 ? 3 : 2;
+	while(value/10 != 0){
 		value /= 10;
 		res++;
 	}
@@ -15,117 +43,152 @@ int get_digits(int value){
 	return res;
 }
 
+// newest first, so vars of the block being run are found without walking the rest
+int find_var_index(Var** vars, size_t vsize, char* name, size_t size){
+	for(size_t i = vsize; i > 0; i--){
+		if((*vars)[i-1].name_size == size && strncmp(name, (*vars)[i-1].name, size) == 0){
+			return (int)(i-1);
+		}
+	}
+
+	return -1;
+}
+
+// flattens the var if it is still a rope, since the caller wants the whole string
 Var find_var(Var** vars, size_t vsize, char* name, size_t size){
-	for(size_t i = 0; i < vsize; i++){
-		if(strncmp(name, (*vars)[i].name, size) == 0){
-			return (*vars)[i];
+	int index = find_var_index(vars, vsize, name, size);
+	if(index < 0){
+		Var var = {0};
+		if(unset_vars_are_zero){
+			var.type = INTEGER;
+			var.str = "0";
+			var.str_size = 1;
 		}
+		return var;
 	}
 
-	Var var = {0};
-	return var;
+	Var* var = &(*vars)[index];
+	if(var->rope != NULL){
+		var->str = rope_flatten(var->rope, &var->str_size);
+		var->rope = NULL;
+	}
+	return *var;
 }
 
 void add_var(Var** vars, size_t* size, size_t* capacity, Var var){
 	if(*size >= *capacity){
 		*capacity *= 2;
-		*vars = realloc((*vars), (*capacity)*sizeof(Var));
+		*vars = mem_realloc((*vars), (*capacity)*sizeof(Var));
 	}
 
 	(*vars)[*size] = var;
 	*size = (*size) + 1;
 }
 
-void update_var(Var** vars, size_t var_count, char* str, size_t size, Var var){
-	for(size_t i = 0; i < var_count; i++){
-		if(strncmp(str, (*vars)[i].name, size) == 0){
-			(*vars)[i] = var;
-			break;
+// goes by size since record fields point into the input and aren't terminated
+int compare_strings(Token* lhs, Token* rhs){
+	size_t shorter = lhs->size < rhs->size ? lhs->size : rhs->size;
+	int value = memcmp(lhs->str, rhs->str, shorter);
+	if(value != 0 || lhs->size == rhs->size){
+		return value;
+	}
+	return lhs->size < rhs->size ? -1 : 1;
+}
+
+int solve_expr(Var** vars, size_t size, Expr expr);
+
+// the value a TEMP statement left, NULL when it couldn't be worked out and the use has to do the math
+Var* temp_value(Var** vars, size_t size, Node* node){
+	Token* name = ast->temps[node->as.temp.temp];
+	int index = find_var_index(vars, size, name->str, name->size);
+	if(index < 0 || (*vars)[index].type != INTEGER){
+		return NULL;
+	}
+	return &(*vars)[index];
+}
+
+// the literal an operand comes down to, nested operations get solved into digits (which the
+// caller owns, on its stack) and vars get looked up into token (pointing at the var's string)
+Token* solve_operand(Var** vars, size_t size, Expr expr, Token* token, char* digits, size_t digits_size){
+	Node* node = NODE(ast, expr);
+	while(node->type == GROUPED || node->type == TEMP){
+		if(node->type == GROUPED){
+			node = NODE(ast, node->as.grouped);
+			continue;
 		}
+		Var* temp = temp_value(vars, size, node);
+		if(temp != NULL){
+			token->type = INTEGER;
+			token->str = temp->str;
+			token->size = temp->str_size;
+			return token;
+		}
+		expr = node->as.temp.expr;
+		node = NODE(ast, expr);
+	}
+	if(node->type == OPERATION){
+		token->type = INTEGER;
+		token->size = snprintf(digits, digits_size, "%d", solve_expr(vars, size, expr));
+		token->str = digits;
+		return token;
+	}
+	if(node->type != LITERAL){
+		return NULL;
+	}
+	Token* literal = node->as.literal;
+	if(literal->type != IDENTIFIER){
+		return literal;
 	}
+	Var var = find_var(vars, size, literal->str, literal->size);
+	if(var.str == NULL){
+		RUN_ERROR("[ERR] Failed to find var %.*s\n", (int)literal->size, literal->str);
+		return NULL;
+	}
+	// resolve into a copy, the token belongs to the lexer and gets evaluated again
+	token->type = var.type;
+	token->str = var.str;
+	token->size = var.str_size;
+	return token;
 }
 
 int solve_expr(Var** vars, size_t size, Expr expr){
-	if(expr.type == GROUPED){
-		expr = expr.as.grouped->expr;
+	Node* node = NODE(ast, expr);
+	if(node->type == GROUPED){
+		node = NODE(ast, node->as.grouped);
 	}
 
-	if(expr.type == LITERAL){
+	if(node->type == LITERAL){
 		return 1;
 	}
 
-	if(expr.type != OPERATION){
+	if(node->type != OPERATION){
 		return 0;
 	}
 
-	Expr lhs = expr.as.operation->lhs;
-	while(lhs.type != LITERAL){
-		if(lhs.type == GROUPED){
-			lhs = lhs.as.grouped->expr;
-			continue;
-		}
-		if(lhs.type == OPERATION){
-			int value = solve_expr(vars, size, lhs);
-			lhs.type = LITERAL;
-			lhs.as.literal = malloc(sizeof(Token));
-			lhs.as.literal->type = INTEGER;
-			int digits = get_digits(value);
-			lhs.as.literal->str = malloc((digits+1)*sizeof(char));
-			snprintf(lhs.as.literal->str, digits, "%d", value);
-			lhs.as.literal->str[digits] = '\0';
-			lhs.as.literal->size = strlen(lhs.as.literal->str);
-		}
-	}
-	if(lhs.as.literal->type == IDENTIFIER){
-		Var var = find_var(vars, size, lhs.as.literal->str, lhs.as.literal->size);
-		if(var.str == NULL){
-			fprintf(stderr, "[ERR] Failed to find var %.*s\n", (int)lhs.as.literal->size, lhs.as.literal->str);
-			return 0;
-		}
-		lhs.as.literal->type = var.type;
-		lhs.as.literal->str = var.str;
-		lhs.as.literal->size = var.str_size;
-	}
-	
-	Expr rhs = expr.as.operation->rhs;
-	while(rhs.type != LITERAL){
-		if(rhs.type == GROUPED){
-			rhs = rhs.as.grouped->expr;
-			continue;
-		}
-		if(rhs.type == OPERATION){
-			int value = solve_expr(vars, size, rhs);
-			rhs.type = LITERAL;
-			rhs.as.literal = malloc(sizeof(Token));
-			rhs.as.literal->type = INTEGER;
-			int digits = get_digits(value);
-			rhs.as.literal->str = malloc((digits+1)*sizeof(char));
-			snprintf(rhs.as.literal->str, digits, "%d", value);
-			rhs.as.literal->str[digits] = '\0';
-			rhs.as.literal->size = strlen(rhs.as.literal->str);
-		}
+	Token lhs_token;
+	char lhs_digits[16];
+	Token* lhs = solve_operand(vars, size, node->as.operation.lhs, &lhs_token, lhs_digits, sizeof(lhs_digits));
+	if(lhs == NULL){
+		return 0;
 	}
-	if(rhs.as.literal->type == IDENTIFIER){
-		Var var = find_var(vars, size, rhs.as.literal->str, rhs.as.literal->size);
-		if(var.str == NULL){
-			fprintf(stderr, "[ERR] Failed to find var %.*s\n", (int)rhs.as.literal->size, rhs.as.literal->str);
-			return 0;
-		}
-		rhs.as.literal->type = var.type;
-		rhs.as.literal->str = var.str;
-		rhs.as.literal->size = var.str_size;
+	Token rhs_token;
+	char rhs_digits[16];
+	Token* rhs = solve_operand(vars, size, node->as.operation.rhs, &rhs_token, rhs_digits, sizeof(rhs_digits));
+	if(rhs == NULL){
+		return 0;
 	}
+	enum TokenType operator = node->as.operation.operator;
 
-	if(lhs.as.literal->type != rhs.as.literal->type){
-		fprintf(stderr, "[ERR] Cannot operate on two different types\n");
+	if(lhs->type != rhs->type){
+		RUN_ERROR("[ERR] Cannot operate on two different types\n");
 		return 0;
 	}
 	
-	if(expr.as.operation->operator >= EQEQ && expr.as.operation->operator <= GTEQ){
+	if(operator >= EQEQ && operator <= GTEQ){
 		// bool
-		if(lhs.as.literal->type == STRING){
-			int value = strcmp(lhs.as.literal->str, rhs.as.literal->str);
-			switch(expr.as.operation->operator){
+		if(lhs->type == STRING){
+			int value = compare_strings(lhs, rhs);
+			switch(operator){
 				case EQEQ: return value == 0;
 				case LT: return value < 0;
 				case LTEQ: return value <= 0;
@@ -135,9 +198,9 @@ int solve_expr(Var** vars, size_t size, Expr expr){
 			}
 		}
 		else{
-			int l = atoi(lhs.as.literal->str);
-			int r = atoi(rhs.as.literal->str);
-			switch(expr.as.operation->operator){
+			int l = atoi(lhs->str);
+			int r = atoi(rhs->str);
+			switch(operator){
 				case EQEQ: return l == r;
 				case LT: return l < r;
 				case LTEQ: return l <= r;
@@ -147,20 +210,27 @@ int solve_expr(Var** vars, size_t size, Expr expr){
 			}
 		}
 	}
-	else if(expr.as.operation->operator >= PLUS && expr.as.operation->operator <= SLASH){
+	else if(operator >= PLUS && operator <= SLASH){
 		// math
-		if(lhs.as.literal->type == STRING){
-			fprintf(stderr, "[ERR] Cannot do non-boolean operations on strings\n");
+		if(lhs->type == STRING){
+			RUN_ERROR("[ERR] Cannot do non-boolean operations on strings, use a var to join them with +\n");
 			return 0;
 		}
 		else{
-			int l = atoi(lhs.as.literal->str);
-			int r = atoi(rhs.as.literal->str);
-			switch(expr.as.operation->operator){
+			int l = atoi(lhs->str);
+			int r = atoi(rhs->str);
+			switch(operator){
 				case PLUS: return l + r;
 				case MINUS: return l - r;
 				case STAR: return l * r;
-				case SLASH: return l / r;
+				case SLASH:
+				{
+					if(r == 0){
+						RUN_ERROR("[ERR] Cannot divide by zero\n");
+						return 0;
+					}
+					return l / r;
+				}
 				default: return 0;
 			}
 		}
@@ -169,251 +239,2433 @@ int solve_expr(Var** vars, size_t size, Expr expr){
 	return 0;
 }
 
-int eval_expressions(Parser parser, Expr* exprs, size_t size){
-	int exit_code = 0;
-	size_t var_count = 0;
-	size_t var_cap = 8;
-	Var* vars = malloc(var_cap*sizeof(Var));
+Expr strip_groups(Expr expr){
+	while(NODE(ast, expr)->type == GROUPED){
+		expr = NODE(ast, expr)->as.grouped;
+	}
+	return expr;
+}
 
-	for(size_t i = 0; i < size; i++){
-		Expr expr = exprs[i];
-		switch(expr.type){
-			case FUNCTION_CALL:
-			{
-				switch(expr.as.function_call->type){
-					case CALL:
-					{
-						if(expr.as.function_call->argc < 1){
-							fprintf(stderr, "[ERR] Call function requires function name to be an argument\n");
-							break;
-						}
-						if(expr.as.function_call->argv[0].type != LITERAL){
-first_arg_func_name_call:
-							fprintf(stderr, "[ERR] Call function requires function name in first argument\n");
-							break;
-						}
-						if(expr.as.function_call->argv[0].as.literal->type != IDENTIFIER){
-							goto first_arg_func_name_call;
-						}
+Expr leftmost_literal(Expr expr){
+	expr = strip_groups(expr);
+	while(NODE(ast, expr)->type == OPERATION || NODE(ast, expr)->type == TEMP){
+		Node* node = NODE(ast, expr);
+		expr = strip_groups(node->type == TEMP ? node->as.temp.expr : node->as.operation.lhs);
+	}
+	return expr;
+}
 
-						Token* name = expr.as.function_call->argv[0].as.literal;
-						int found_index = -1;
-						for(size_t j = 0; j < parser.function_count; j++){
-							if(strncmp(name->str, parser.functions[j].name, name->size) == 0){
-								found_index = (int)j;
-								break;
-							}
-						}
-						if(found_index < 0){
-							fprintf(stderr, "[ERR] Function %.*s does not exist\n", (int)name->size, name->str);
-							break;
-						}
+// a + chain is a string join when the value it starts from is a string
+int is_string_join(Var** vars, size_t size, Expr expr){
+	Node* node = NODE(ast, strip_groups(expr));
+	if(node->type != OPERATION || node->as.operation.operator != PLUS){
+		return 0;
+	}
+	Node* first = NODE(ast, leftmost_literal(expr));
+	if(first->type != LITERAL){
+		return 0;
+	}
+	if(first->as.literal->type == STRING){
+		return 1;
+	}
+	if(first->as.literal->type == IDENTIFIER){
+		int index = find_var_index(vars, size, first->as.literal->str, first->as.literal->size);
+		return index >= 0 && (*vars)[index].type == STRING;
+	}
+	return 0;
+}
 
-						int param_count = expr.as.function_call->argc-1;
-						if(param_count != (int)parser.functions[found_index].argc){
-							fprintf(stderr, "[ERR] Call function needs all parameters required by function being called\n");
-							break;
-						}
-						size_t func_size = param_count + parser.functions[found_index].size;
-						Expr* func_exprs = malloc(sizeof(Expr)*func_size);
-						for(size_t j = 0; j < func_size; j++){
-							if((int)j >= param_count){
-								func_exprs[j] = parser.functions[found_index].exprs[j-param_count];
-							}
-							else{
-								Var var = find_var(&vars, var_count, expr.as.function_call->argv[j+1].as.literal->str, expr.as.function_call->argv[j+1].as.literal->size);
-								if(var.str == NULL){
-									fprintf(stderr, "[ERR] Cannot find variable %s\n", expr.as.function_call->argv[j+1].as.literal->str);
-									goto end_call_function_call;
-								}
-								Expr param_expr = {0};
-								param_expr.type = FUNCTION_CALL;
-								param_expr.as.function_call = malloc(sizeof(struct Expr_Function_Call));
-								param_expr.as.function_call->type = VAR;
-								param_expr.as.function_call->argc = 2;
-								param_expr.as.function_call->argv = malloc(sizeof(Expr)*2);
-
-								param_expr.as.function_call->argv[0].type = LITERAL;
-								param_expr.as.function_call->argv[0].as.literal = malloc(sizeof(Token));
-								param_expr.as.function_call->argv[0].as.literal->type = IDENTIFIER;
-								param_expr.as.function_call->argv[0].as.literal->size = parser.functions[found_index].argv[j].size;
-								param_expr.as.function_call->argv[0].as.literal->str = malloc(sizeof(char)*(parser.functions[found_index].argv[j].size+1));
-								strncpy(param_expr.as.function_call->argv[0].as.literal->str, parser.functions[found_index].argv[j].str, parser.functions[found_index].argv[j].size);
-								param_expr.as.function_call->argv[0].as.literal->str[parser.functions[found_index].argv[j].size] = '\0';
-
-								param_expr.as.function_call->argv[1].type = LITERAL;
-								param_expr.as.function_call->argv[1].as.literal = malloc(sizeof(Token));
-								param_expr.as.function_call->argv[1].as.literal->type = var.type;
-								param_expr.as.function_call->argv[1].as.literal->size = var.str_size;
-								param_expr.as.function_call->argv[1].as.literal->str = malloc(sizeof(char)*(var.str_size+1));
-								strncpy(param_expr.as.function_call->argv[1].as.literal->str, var.str, var.str_size);
-								param_expr.as.function_call->argv[1].as.literal->str[var.str_size] = '\0';
-
-								func_exprs[j] = param_expr;
-							}
-						}
+// copies every piece of the join onto the rope without flattening any rope vars it reads
+int append_string_join(Rope* rope, Var** vars, size_t size, Expr expr, int skip_first){
+	Node* node = NODE(ast, strip_groups(expr));
+	// a temp only ever holds an integer, so it is whatever the math it stands for would have been
+	if(node->type == TEMP){
+		return append_string_join(rope, vars, size, node->as.temp.expr, skip_first);
+	}
+	if(node->type == OPERATION){
+		if(node->as.operation.operator != PLUS){
+			RUN_ERROR("[ERR] Strings can only be joined with +\n");
+			return 1;
+		}
+		if(append_string_join(rope, vars, size, node->as.operation.lhs, skip_first) != 0){
+			return 1;
+		}
+		return append_string_join(rope, vars, size, node->as.operation.rhs, 0);
+	}
+	if(node->type != LITERAL){
+		RUN_ERROR("[ERR] String join does not support expression type %i\n", node->type);
+		return 1;
+	}
+	if(skip_first){
+		return 0;
+	}
 
-						int func_exit_code = eval_expressions(parser, func_exprs, func_size);
-						if(func_exit_code != 0){
-							exit_code = func_exit_code;
-						}
+	Token* literal = node->as.literal;
+	if(literal->type == STRING){
+		rope_append(rope, literal->str, literal->size);
+		return 0;
+	}
+	if(literal->type == IDENTIFIER){
+		int index = find_var_index(vars, size, literal->str, literal->size);
+		if(index < 0){
+			RUN_ERROR("[ERR] Failed to find var %.*s\n", (int)literal->size, literal->str);
+			return 1;
+		}
+		Var* var = &(*vars)[index];
+		if(var->type != STRING){
+			RUN_ERROR("[ERR] Cannot operate on two different types\n");
+			return 1;
+		}
+		if(var->rope == NULL){
+			rope_append(rope, var->str, var->str_size);
+			return 0;
+		}
+		// the var can be the rope being appended to, so only take the pieces it has now
+		size_t piece_count = var->rope->piece_count;
+		for(size_t i = 0; i < piece_count; i++){
+			rope_append(rope, var->rope->pieces[i], var->rope->piece_sizes[i]);
+		}
+		return 0;
+	}
 
-end_call_function_call:
+	RUN_ERROR("[ERR] Cannot operate on two different types\n");
+	return 1;
+}
 
-						free(func_exprs);
+// frees whatever the var's string (or map) lives in, borrowed ones belong to someone else
+void release_str(Var* var){
+	if(var->map != NULL){
+		if(!var->borrowed){
+			free_map(var->map);
+		}
+		var->map = NULL;
+	}
+	else if(var->mapped){
+		unmap_file(var->str, var->str_size);
+	}
+	else if(!var->borrowed){
+		mem_free(var->str);
+	}
+	var->str = NULL;
+	var->borrowed = 0;
+	var->mapped = 0;
+}
 
-						break;
-					}
-					case PRINT:
-					{
-						for(size_t j = 0; j < expr.as.function_call->argc; j++){
-							Expr arg = expr.as.function_call->argv[j];
-							switch(expr.as.function_call->argv[i].type){
-								case OPERATION: printf("%d", solve_expr(&vars, var_count, arg)); break;
-								case LITERAL:
-								{
-									if(arg.as.literal->type != IDENTIFIER){
-										printf("%s", arg.as.literal->str);
-									}
-									else{
-										Var var = find_var(&vars, var_count, arg.as.literal->str, arg.as.literal->size);
-										printf("%s", var.str);
-									}
-									break;
-								}
-								case GROUPED:
-								{
-									if(arg.as.grouped->expr.type == OPERATION){
-										printf("%d", solve_expr(&vars, var_count, arg.as.grouped->expr));
-									}
-									else{
-										printf("%s", arg.as.grouped->expr.as.literal->str);
-									}
-									break;
-								}
-								default: break;
-							}
-						}
-						printf("\n");
-						break;
-					}
-					case VAR:
-					{
-						if(expr.as.function_call->argc != 2){
-							fprintf(stderr, "[ERR] Var call requires 2 args, the variable and the value\n");
-							break;
-						}
-						if(expr.as.function_call->argv[0].type != LITERAL){
-first_arg_name_error:
-							fprintf(stderr, "[ERR] Var call requires first arg to be var name\n");
-							break;
-						}
-						Token* name = expr.as.function_call->argv[0].as.literal;
-						if(name->type != IDENTIFIER){
-							goto first_arg_name_error;
-						}
+// gives the var its own copy of a borrowed or mapped string (or map)
+void own_str(Var* var){
+	if(!var->borrowed && !var->mapped){
+		return;
+	}
+	if(var->map != NULL){
+		var->map = copy_map(var->map);
+		var->borrowed = 0;
+		return;
+	}
+	char* str = mem_alloc(sizeof(char)*(var->str_size+1));
+	memcpy(str, var->str, var->str_size);
+	str[var->str_size] = '\0';
+	release_str(var);
+	var->str = str;
+}
 
-						Expr arg2 = expr.as.function_call->argv[1];
-set_value:
-						Token value;
-						if(arg2.type == LITERAL){
-							value = *arg2.as.literal;
-							if(value.type == IDENTIFIER){
-								Var rhs = find_var(&vars, var_count, value.str, value.size);
-								if(rhs.str == NULL){
-									fprintf(stderr, "[ERR] Cannot find variable %s\n", value.str);
-									break;
-								}
-								value.type = rhs.type;
-								value.size = rhs.str_size;
-								free(value.str);
-								value.str = malloc(sizeof(char)*(rhs.str_size+1));
-								strncpy(value.str, rhs.str, rhs.str_size);
-								value.str[rhs.str_size] = '\0';
-							}
-						}
-						else if(arg2.type == GROUPED){
-							arg2 = arg2.as.grouped->expr;
-							goto set_value;
-						}
-						else if(arg2.type == OPERATION){
-							int v = solve_expr(&vars, var_count, arg2);
-							int digits = get_digits(v);
-							value.str = malloc((digits+1)*sizeof(char));
-							snprintf(value.str, digits, "%d", v);
-							value.str[digits] = '\0';
-							value.size = strlen(value.str);
-							value.type = INTEGER;
-						}
-						else{
-							fprintf(stderr, "[ERR] Var call cannot take function calls in the arguments\n");
-							break;
-						}
-
-						Var var = find_var(&vars, var_count, name->str, name->size);
-						if(var.str != NULL){
-							var.str_size = value.size;
-							var.str = realloc(var.str, sizeof(char)*(value.size+1));
-							strncpy(var.str, value.str, value.size);
-							var.str[value.size] = '\0';
-							var.type = value.type;
-							update_var(&vars, var_count, name->str, name->size, var);
-						}
-						else{
-							var.str_size = value.size;
-							var.str = malloc(sizeof(char)*(value.size+1));
-							strncpy(var.str, value.str, value.size);
-							var.str[value.size] = '\0';
-							var.type = value.type;
-							var.name_size = name->size;
-							var.name = malloc(sizeof(char)*(name->size+1));
-							strncpy(var.name, name->str, name->size);
-							var.name[name->size] = '\0';
-							add_var(&vars, &var_count, &var_cap, var);
-						}
-						break;
+// takes ownership of the value's string (or rope)
+void assign_var(Var** vars, size_t* var_count, size_t* var_cap, Token* name, Var value){
+	int index = find_var_index(vars, *var_count, name->str, name->size);
+	if(index >= 0){
+		Var* var = &(*vars)[index];
+		release_str(var);
+		if(var->rope != NULL){
+			free_rope(var->rope);
+		}
+		var->type = value.type;
+		var->str = value.str;
+		var->str_size = value.str_size;
+		var->rope = value.rope;
+		var->borrowed = value.borrowed;
+		var->mapped = value.mapped;
+		var->map = value.map;
+		return;
+	}
+
+	value.name_size = name->size;
+	value.name = mem_alloc(sizeof(char)*(name->size+1));
+	strncpy(value.name, name->str, name->size);
+	value.name[name->size] = '\0';
+	add_var(vars, var_count, var_cap, value);
+}
+
+// `var s s + ...` appends onto the existing rope instead of copying s every time
+int set_string_join(Var** vars, size_t* var_count, size_t* var_cap, Token* name, Expr expr){
+	int index = find_var_index(vars, *var_count, name->str, name->size);
+	Token* first = NODE(ast, leftmost_literal(expr))->as.literal;
+	if(index >= 0 && (*vars)[index].type == STRING
+	&& first->type == IDENTIFIER
+	&& first->size == name->size
+	&& strncmp(first->str, name->str, name->size) == 0){
+		Var* var = &(*vars)[index];
+		if(var->rope == NULL){
+			var->rope = new_rope();
+			if(var->borrowed || var->mapped){
+				rope_append(var->rope, var->str, var->str_size);
+				release_str(var);
+			}
+			else{
+				rope_adopt(var->rope, var->str, var->str_size);
+			}
+			var->str = NULL;
+		}
+		int res = append_string_join(var->rope, vars, *var_count, expr, 1);
+		var->str_size = var->rope->size;
+		return res;
+	}
+
+	Rope* rope = new_rope();
+	if(append_string_join(rope, vars, *var_count, expr, 0) != 0){
+		free_rope(rope);
+		return 1;
+	}
+
+	Var value = {0};
+	value.type = STRING;
+	value.str_size = rope->size;
+	value.rope = rope;
+	assign_var(vars, var_count, var_cap, name, value);
+	return 0;
+}
+
+void print_string_join(FILE* out, Var** vars, size_t size, Expr expr){
+	Rope* rope = new_rope();
+	if(append_string_join(rope, vars, size, expr, 0) == 0){
+		rope_write(rope, out);
+	}
+	free_rope(rope);
+}
+
+void set_var_int(Var* var, int value){
+	int digits = get_digits(value);
+	if(var->borrowed || var->mapped || var->map != NULL){
+		release_str(var);
+	}
+	var->str = mem_realloc(var->str, sizeof(char)*digits);
+	snprintf(var->str, digits, "%d", value);
+	var->str_size = strlen(var->str);
+	var->type = INTEGER;
+}
+
+// the type guard for jit code, every var it touches has to exist and be an INTEGER
+int load_jit_slots(Var** vars, size_t size, Jit_Code* code, int* slots, int* indices){
+	for(size_t i = 0; i < code->slot_count; i++){
+		Token* name = code->slot_names[i];
+		if(code->scratch[i]){
+			slots[i] = 0;
+			indices[i] = -1;
+			continue;
+		}
+		int index = find_var_index(vars, size, name->str, name->size);
+		if(index < 0 || (*vars)[index].type != INTEGER){
+			return 1;
+		}
+		slots[i] = atoi((*vars)[index].str);
+		indices[i] = index;
+	}
+	return 0;
+}
+
+int solve_int_expr(Var** vars, size_t size, Expr expr){
+	expr = strip_groups(expr);
+	Node* node = NODE(ast, expr);
+	if(node->type == TEMP){
+		Var* temp = temp_value(vars, size, node);
+		if(temp != NULL){
+			return atoi(temp->str);
+		}
+		expr = strip_groups(node->as.temp.expr);
+		node = NODE(ast, expr);
+	}
+	if(node->type == LITERAL){
+		Token* literal = node->as.literal;
+		if(literal->type == INTEGER){
+			return atoi(literal->str);
+		}
+		Var var = find_var(vars, size, literal->str, literal->size);
+		if(var.str == NULL || var.type != INTEGER){
+			RUN_ERROR("[ERR] Expected %.*s to be an integer\n", (int)literal->size, literal->str);
+			return 0;
+		}
+		return atoi(var.str);
+	}
+	if(!jit_enabled || node->type != OPERATION){
+		return solve_expr(vars, size, expr);
+	}
+
+	Jit_Entry* entry = jit_entry(jit_cache, node);
+	if(entry->code == NULL && !entry->failed){
+		entry->hits++;
+		if(entry->hits >= JIT_HOT_COUNT){
+			entry->code = jit_compile_expr(ast, expr);
+			entry->failed = entry->code == NULL;
+		}
+	}
+	int slots[JIT_MAX_SLOTS];
+	int indices[JIT_MAX_SLOTS];
+	if(entry->code == NULL
+	|| load_jit_slots(vars, size, entry->code, slots, indices) != 0
+	|| entry->code->entry(slots) != 0){
+		// deopt, the interpreter handles whatever the native code couldn't
+		return solve_expr(vars, size, expr);
+	}
+
+	int value = slots[entry->code->result_slot];
+	if(jit_verify){
+		int expected = solve_expr(vars, size, expr);
+		if(value != expected){
+			fprintf(stderr, "[DEBG] Jit gave %d but the interpreter gave %d\n", value, expected);
+		}
+	}
+	return value;
+}
+
+// solve_expr without reporting anything, 0 if it would have hit an error (a string, a var that
+// isn't set or dividing by zero) so that is left to where the math really gets used
+int solve_quietly(Var** vars, size_t size, Expr expr, int* value){
+	Node* node = NODE(ast, strip_groups(expr));
+	switch(node->type){
+		case TEMP:
+		{
+			Var* temp = temp_value(vars, size, node);
+			if(temp != NULL){
+				*value = atoi(temp->str);
+				return 1;
+			}
+			return solve_quietly(vars, size, node->as.temp.expr, value);
+		}
+		case LITERAL:
+		{
+			Token* literal = node->as.literal;
+			if(literal->type == INTEGER){
+				*value = atoi(literal->str);
+				return 1;
+			}
+			if(literal->type != IDENTIFIER){
+				return 0;
+			}
+			Var var = find_var(vars, size, literal->str, literal->size);
+			if(var.str == NULL || var.type != INTEGER){
+				return 0;
+			}
+			*value = atoi(var.str);
+			return 1;
+		}
+		case OPERATION:
+		{
+			int l = 0;
+			int r = 0;
+			if(!solve_quietly(vars, size, node->as.operation.lhs, &l) || !solve_quietly(vars, size, node->as.operation.rhs, &r)){
+				return 0;
+			}
+			switch(node->as.operation.operator){
+				case EQEQ: *value = l == r; return 1;
+				case LT: *value = l < r; return 1;
+				case LTEQ: *value = l <= r; return 1;
+				case GT: *value = l > r; return 1;
+				case GTEQ: *value = l >= r; return 1;
+				case PLUS: *value = l + r; return 1;
+				case MINUS: *value = l - r; return 1;
+				case STAR: *value = l * r; return 1;
+				case SLASH:
+				{
+					if(r == 0){
+						return 0;
 					}
-					default: break;
+					*value = l / r;
+					return 1;
 				}
-				break;
+				default: return 0;
 			}
-			default: break;
+		}
+		default: return 0;
+	}
+}
+
+// a TEMP statement, when the math can't be done quietly the temp is left as an empty string
+// so its uses work it out themselves and report whatever went wrong where it happens
+void set_temp(Var** vars, size_t* var_count, size_t* var_cap, Node* node){
+	Token* name = ast->temps[node->as.temp.temp];
+	int value = 0;
+	int solved = solve_quietly(vars, *var_count, node->as.temp.expr, &value);
+	int index = find_var_index(vars, *var_count, name->str, name->size);
+	if(index >= 0 && solved){
+		set_var_int(&(*vars)[index], value);
+		return;
+	}
+	Var temp = {0};
+	if(solved){
+		set_var_int(&temp, value);
+	}
+	else{
+		temp.type = STRING;
+		temp.str = mem_calloc(1, sizeof(char));
+	}
+	assign_var(vars, var_count, var_cap, name, temp);
+}
+
+// runs a hot for loop natively, returns 0 if the interpreter has to run it instead
+int run_jit_loop(Var** vars, size_t var_count, Expr* exprs, size_t for_index, size_t end_index, size_t* next){
+	Jit_Entry* entry = jit_entry(jit_cache, NODE(ast, exprs[for_index]));
+	if(entry->failed){
+		return 0;
+	}
+	if(entry->code == NULL){
+		entry->hits++;
+		if(entry->hits < JIT_HOT_COUNT){
+			return 0;
+		}
+		entry->code = jit_compile_loop(ast, exprs, for_index, end_index);
+		if(entry->code == NULL){
+			entry->failed = 1;
+			return 0;
 		}
 	}
 
-	return exit_code;
+	int slots[JIT_MAX_SLOTS];
+	int indices[JIT_MAX_SLOTS];
+	if(load_jit_slots(vars, var_count, entry->code, slots, indices) != 0){
+		return 0;
+	}
+	int status = entry->code->entry(slots);
+	for(size_t i = 0; i < entry->code->slot_count; i++){
+		int index = indices[i];
+		if(entry->code->scratch[i]){
+			// a temp left over from before has to agree with the code if the interpreter picks up after a deopt
+			Token* name = entry->code->slot_names[i];
+			index = find_var_index(vars, var_count, name->str, name->size);
+		}
+		if(index < 0){
+			continue;
+		}
+		Var* var = &(*vars)[index];
+		if(atoi(var->str) != slots[i]){
+			set_var_int(var, slots[i]);
+		}
+	}
+
+	if(status == JIT_LOOP_LIMIT){
+		// the for runs interpreted this time round, which reports what went wrong with the limit
+		return 0;
+	}
+	if(status == 0){
+		*next = end_index;
+	}
+	else{
+		// the interpreter carries on from the body statement that deopted
+		*next = for_index + status - 1;
+	}
+	return 1;
 }
 
-int run_code(char* src, size_t size, int debug_mode){
-	int exit_code = 0;
-	Parser parser = {0};
-	Lexer lexer = lex(src, size);
-	if(debug_mode == 0){
-		print_lexer(lexer);
+// fills out with its own copy of the value of arg
+int solve_value(Var** vars, size_t size, Expr arg, Var* out){
+	arg = strip_groups(arg);
+	if(is_string_join(vars, size, arg)){
+		Rope* rope = new_rope();
+		if(append_string_join(rope, vars, size, arg, 0) != 0){
+			free_rope(rope);
+			return 1;
+		}
+		out->type = STRING;
+		out->str = rope_flatten(rope, &out->str_size);
+		return 0;
 	}
-	if(lexer.exit_code != 0){
-		printf("[INFO] Lexer had error, stopping here\n");
-		exit_code = lexer.exit_code;
-		goto finish_running;
+	Node* node = NODE(ast, arg);
+	if(node->type == OPERATION){
+		out->str = NULL;
+		set_var_int(out, solve_int_expr(vars, size, arg));
+		return 0;
+	}
+	if(node->type != LITERAL){
+		RUN_ERROR("[ERR] Expression type %i cannot be used as a value\n", node->type);
+		return 1;
 	}
 
-	parser = parse(lexer);
-	if(debug_mode == 0){
-		print_parser(parser);
+	Token* literal = node->as.literal;
+	enum TokenType type = literal->type;
+	char* str = literal->str;
+	size_t str_size = literal->size;
+	if(type == IDENTIFIER){
+		Var var = find_var(vars, size, literal->str, literal->size);
+		if(var.type == MAP){
+			RUN_ERROR("[ERR] Map %.*s can only be copied with var, passed to a function or returned\n", (int)literal->size, literal->str);
+			return 1;
+		}
+		if(var.str == NULL){
+			RUN_ERROR("[ERR] Cannot find variable %.*s\n", (int)literal->size, literal->str);
+			return 1;
+		}
+		type = var.type;
+		str = var.str;
+		str_size = var.str_size;
 	}
-	if(parser.exit_code != 0){
-		printf("[INFO] Parser had error, stopping here\n");
-		exit_code = parser.exit_code;
-		goto finish_running;
+	out->type = type;
+	out->str_size = str_size;
+	out->str = mem_alloc(sizeof(char)*(str_size+1));
+	strncpy(out->str, str, str_size);
+	out->str[str_size] = '\0';
+	return 0;
+}
+
+// the map var expr names, NULL (after an error) if it isn't one
+Var* find_map(Var** vars, size_t size, Expr expr, const char* what){
+	Node* node = NODE(ast, expr);
+	if(node->type != LITERAL || node->as.literal->type != IDENTIFIER){
+		RUN_ERROR("[ERR] %s requires a map var first\n", what);
+		return NULL;
 	}
+	Token* name = node->as.literal;
+	int index = find_var_index(vars, size, name->str, name->size);
+	if(index < 0 || (*vars)[index].type != MAP){
+		RUN_ERROR("[ERR] %s requires a map var first, %.*s isn't one\n", what, (int)name->size, name->str);
+		return NULL;
+	}
+	return &(*vars)[index];
+}
 
-	exit_code = eval_expressions(parser, parser.exprs, parser.size);
+// integer keys are written out again so 007 and 7 are the same key
+int solve_key(Var** vars, size_t size, Expr expr, Var* key){
+	if(solve_value(vars, size, expr, key) != 0){
+		return 1;
+	}
+	if(key->type == INTEGER){
+		set_var_int(key, atoi(key->str));
+	}
+	return 0;
+}
 
+// `var m map k v k v ...`, the values can be anything solve_value takes
+int make_map(Var** vars, size_t size, struct Expr_Function_Call* call, Var* out){
+	if(call->argc%2 != 0){
+		RUN_ERROR("[ERR] Map requires a value after every key\n");
+		return 1;
+	}
+	Map* map = new_map();
+	for(size_t i = 0; i < call->argc; i += 2){
+		Var key = {0};
+		Var value = {0};
+		if(solve_key(vars, size, call->argv[i], &key) != 0){
+			free_map(map);
+			return 1;
+		}
+		if(solve_value(vars, size, call->argv[i+1], &value) != 0){
+			mem_free(key.str);
+			free_map(map);
+			return 1;
+		}
+		map_set(map, key.type, key.str, key.str_size, value.type, value.str, value.str_size);
+	}
+	out->type = MAP;
+	out->map = map;
+	return 0;
+}
 
-finish_running:
-	if(parser.exprs != NULL){
-		free_parser(&parser);
+// `var v get m key` (0, or the value after the key, when the key isn't there) and `var b has m key`
+int read_map(Var** vars, size_t size, struct Expr_Function_Call* call, Var* out){
+	const char* what = call->type == GET ? "Get" : "Has";
+	size_t most = call->type == GET ? 3 : 2;
+	if(call->argc < 2 || call->argc > most){
+		RUN_ERROR("[ERR] %s requires the map and the key%s\n", what, call->type == GET ? ", and maybe what to give back when it's missing" : "");
+		return 1;
+	}
+	Var* map = find_map(vars, size, call->argv[0], what);
+	if(map == NULL){
+		return 1;
+	}
+	Var key = {0};
+	if(solve_key(vars, size, call->argv[1], &key) != 0){
+		return 1;
+	}
+	Map_Entry* entry = map_get(map->map, key.type, key.str, key.str_size);
+	mem_free(key.str);
+	if(call->type == HAS){
+		out->str = NULL;
+		set_var_int(out, entry != NULL);
+		return 0;
+	}
+	if(entry == NULL && call->argc == 3){
+		return solve_value(vars, size, call->argv[2], out);
+	}
+	if(entry == NULL){
+		out->str = NULL;
+		set_var_int(out, 0);
+		return 0;
+	}
+	out->type = entry->type;
+	out->str_size = entry->value_size;
+	out->str = mem_alloc(sizeof(char)*(entry->value_size+1));
+	memcpy(out->str, entry->value, entry->value_size+1);
+	return 0;
+}
+
+// `var copy m` and `return m`, maps get copied like strings do
+Var* map_source(Var** vars, size_t size, Expr expr){
+	Node* node = NODE(ast, expr);
+	if(node->type != LITERAL || node->as.literal->type != IDENTIFIER){
+		return NULL;
+	}
+	int index = find_var_index(vars, size, node->as.literal->str, node->as.literal->size);
+	return index >= 0 && (*vars)[index].type == MAP ? &(*vars)[index] : NULL;
+}
+
+// the loop var of `each key m` gets its own copy of the key
+void bind_map_key(Var** vars, size_t* var_count, size_t* var_cap, Token* name, Map_Entry* entry){
+	Var key = {0};
+	key.type = entry->key_type;
+	key.str_size = entry->key_size;
+	key.str = mem_alloc(sizeof(char)*(entry->key_size+1));
+	memcpy(key.str, entry->key, entry->key_size+1);
+	assign_var(vars, var_count, var_cap, name, key);
+}
+
+// joins every arg from start on into one string, the same way print would show them
+char* build_command(Var** vars, size_t size, struct Expr_Function_Call* call, size_t start){
+	if(start >= call->argc){
+		RUN_ERROR("[ERR] Missing the command to run\n");
+		return NULL;
+	}
+	Rope* rope = new_rope();
+	for(size_t i = start; i < call->argc; i++){
+		Var value = {0};
+		if(solve_value(vars, size, call->argv[i], &value) != 0){
+			free_rope(rope);
+			return NULL;
+		}
+		rope_adopt(rope, value.str, value.str_size);
+	}
+	size_t command_size = 0;
+	return rope_flatten(rope, &command_size);
+}
+
+// runs the command and waits for it, returning what it printed when capture is set
+int run_command(Var** vars, size_t size, struct Expr_Function_Call* call, int capture, Var* out){
+	char* command = build_command(vars, size, call, 0);
+	if(command == NULL){
+		return 1;
+	}
+	Shell_Job job = {0};
+	int res = shell_start(command, capture, &job);
+	mem_free(command);
+	if(res != 0){
+		return 1;
+	}
+	shell_wait_all(&job, 1);
+	if(capture){
+		out->type = STRING;
+		out->str = job.out;
+		out->str_size = job.out_size;
+	}
+	return 0;
+}
+
+// `var text load "path"` maps the file instead of reading it, the var is the mapping itself
+int load_file(Var** vars, size_t size, struct Expr_Function_Call* call, Var* out){
+	if(call->argc != 1){
+		RUN_ERROR("[ERR] Load requires the path of the file to load\n");
+		return 1;
+	}
+	Var path = {0};
+	if(solve_value(vars, size, call->argv[0], &path) != 0){
+		return 1;
+	}
+	char* data = NULL;
+	size_t data_size = 0;
+	int res = map_file(path.str, &data, &data_size);
+	mem_free(path.str);
+	if(res != 0){
+		return 1;
+	}
+	out->type = STRING;
+	if(data == NULL){
+		out->str = "";
+		out->borrowed = 1;
+	}
+	else{
+		out->str = data;
+		out->str_size = data_size;
+		out->mapped = 1;
+	}
+	return 0;
+}
+
+// pairs every for/while/if with its end (both ways), unmatched ones point past the last expr
+size_t* match_blocks(Expr* exprs, size_t size){
+	size_t* blocks = mem_alloc(sizeof(size_t)*(size+1));
+	size_t* openers = mem_alloc(sizeof(size_t)*(size+1));
+	size_t depth = 0;
+	for(size_t i = 0; i < size; i++){
+		blocks[i] = size;
+		if(NODE(ast, exprs[i])->type != FUNCTION_CALL){
+			continue;
+		}
+		enum TokenType type = NODE(ast, exprs[i])->as.function_call.type;
+		if(type == FOR || type == WHILE || type == IF || type == EACH || type == PFOR){
+			openers[depth] = i;
+			depth++;
+		}
+		else if(type == END && depth > 0){
+			depth--;
+			blocks[openers[depth]] = i;
+			blocks[i] = openers[depth];
+		}
+	}
+	mem_free(openers);
+	return blocks;
+}
+
+void free_var(Var* var){
+	mem_free(var->name);
+	release_str(var);
+	if(var->rope != NULL){
+		free_rope(var->rope);
+	}
+}
+
+void drop_params(Frame_Stack* stack){
+	for(size_t j = 0; j < stack->param_count; j++){
+		free_var(&stack->params[j]);
+	}
+	stack->param_count = 0;
+}
+
+Frame_Stack new_frame_stack(size_t max_depth){
+	Frame_Stack stack = {
+		.depth = 0,
+		.capacity = max_depth < 64 ? max_depth : 64,
+		.max_depth = max_depth,
+		.param_count = 0,
+		.param_capacity = 8,
+		.has_returned = 0,
+	};
+	stack.frames = mem_calloc(stack.capacity, sizeof(Frame));
+	stack.params = mem_alloc(stack.param_capacity*sizeof(Var));
+	return stack;
+}
+
+// frames past the depth keep their var tables so calls reuse them instead of allocating
+Frame* push_frame(Frame_Stack* stack){
+	if(stack->depth >= stack->capacity){
+		size_t old_capacity = stack->capacity;
+		stack->capacity *= 2;
+		if(stack->capacity > stack->max_depth){
+			stack->capacity = stack->max_depth;
+		}
+		stack->frames = mem_realloc(stack->frames, stack->capacity*sizeof(Frame));
+		memset(stack->frames+old_capacity, 0, (stack->capacity-old_capacity)*sizeof(Frame));
+	}
+	Frame* frame = &stack->frames[stack->depth];
+	stack->depth++;
+	if(frame->vars == NULL){
+		frame->var_cap = 8;
+		frame->vars = mem_alloc(frame->var_cap*sizeof(Var));
+		frame->scope_capacity = 4;
+		frame->scopes = mem_alloc(frame->scope_capacity*sizeof(size_t));
+	}
+	frame->var_count = 0;
+	frame->scope_count = 0;
+	frame->pc = 0;
+	frame->return_name = NULL;
+	frame->memo_key = NULL;
+	return frame;
+}
+
+void clear_frame_vars(Frame* frame){
+	for(size_t i = 0; i < frame->var_count; i++){
+		free_var(&frame->vars[i]);
+	}
+	frame->var_count = 0;
+	frame->scope_count = 0;
+}
+
+// called when a block's body starts, everything made after this belongs to the block
+void open_scope(Frame* frame, size_t var_count){
+	if(frame->scope_count >= frame->scope_capacity){
+		frame->scope_capacity *= 2;
+		frame->scopes = mem_realloc(frame->scopes, frame->scope_capacity*sizeof(size_t));
+	}
+	frame->scopes[frame->scope_count] = var_count;
+	frame->scope_count++;
+}
+
+// called at the block's end, vars are only ever added at the back so the block's are the last ones
+void close_scope(Frame* frame, Var* vars, size_t* var_count){
+	if(frame->scope_count == 0){
+		return;
+	}
+	frame->scope_count--;
+	size_t mark = frame->scopes[frame->scope_count];
+	for(size_t i = mark; i < *var_count; i++){
+		free_var(&vars[i]);
+	}
+	if(mark < *var_count){
+		*var_count = mark;
+	}
+}
+
+void pop_frame(Frame_Stack* stack){
+	stack->depth--;
+	clear_frame_vars(&stack->frames[stack->depth]);
+	mem_free(stack->frames[stack->depth].memo_key);
+	stack->frames[stack->depth].memo_key = NULL;
+}
+
+void free_frame_stack(Frame_Stack* stack){
+	while(stack->depth > 0){
+		pop_frame(stack);
+	}
+	for(size_t i = 0; i < stack->capacity; i++){
+		mem_free(stack->frames[i].vars);
+		mem_free(stack->frames[i].scopes);
+	}
+	mem_free(stack->frames);
+	stack->frames = NULL;
+	drop_params(stack);
+	mem_free(stack->params);
+	stack->params = NULL;
+	if(stack->has_returned){
+		free_var(&stack->returned);
+		stack->has_returned = 0;
+	}
+}
+
+// copies the call's argument values out of the caller before its frame can be reused
+int collect_params(Frame_Stack* stack, Var** vars, size_t var_count, Function* function, struct Expr_Function_Call* call){
+	stack->param_count = 0;
+	for(size_t j = 0; j < function->argc; j++){
+		Node* arg = NODE(ast, call->argv[j+1]);
+		if(arg->type != LITERAL){
+			RUN_ERROR("[ERR] Call function parameters have to be vars or values\n");
+			goto bad_param;
+		}
+		Var param = {0};
+		Token* value = arg->as.literal;
+		if(value->type == IDENTIFIER){
+			Var var = find_var(vars, var_count, value->str, value->size);
+			if(var.type == MAP){
+				param.type = MAP;
+				param.map = copy_map(var.map);
+			}
+			else if(var.str == NULL){
+				RUN_ERROR("[ERR] Cannot find variable %.*s\n", (int)value->size, value->str);
+				goto bad_param;
+			}
+			else{
+				param.type = var.type;
+				param.str_size = var.str_size;
+				param.str = mem_alloc(sizeof(char)*(var.str_size+1));
+				strncpy(param.str, var.str, var.str_size);
+				param.str[var.str_size] = '\0';
+			}
+		}
+		else{
+			param.type = value->type;
+			param.str_size = value->size;
+			param.str = mem_alloc(sizeof(char)*(value->size+1));
+			strncpy(param.str, value->str, value->size);
+			param.str[value->size] = '\0';
+		}
+		param.name_size = function->argv[j].size;
+		param.name = mem_alloc(sizeof(char)*(param.name_size+1));
+		strncpy(param.name, function->argv[j].str, param.name_size);
+		param.name[param.name_size] = '\0';
+		add_var(&stack->params, &stack->param_count, &stack->param_capacity, param);
+	}
+	return 0;
+
+bad_param:
+	drop_params(stack);
+	return 1;
+}
+
+void bind_params(Frame_Stack* stack, Frame* frame){
+	for(size_t j = 0; j < stack->param_count; j++){
+		add_var(&frame->vars, &frame->var_count, &frame->var_cap, stack->params[j]);
+	}
+	stack->param_count = 0;
+}
+
+// checks a call and collects its arguments, returns the function index or -1
+int prepare_call(Frame_Stack* stack, Var** vars, size_t var_count, struct Expr_Function_Call* call){
+	if(call->argc < 1){
+		RUN_ERROR("[ERR] Call function requires function name to be an argument\n");
+		return -1;
+	}
+	if(NODE(ast, call->argv[0])->type != LITERAL || NODE(ast, call->argv[0])->as.literal->type != IDENTIFIER){
+		RUN_ERROR("[ERR] Call function requires function name in first argument\n");
+		return -1;
+	}
+
+	Token* name = NODE(ast, call->argv[0])->as.literal;
+	int found_index = find_function(*ast, name);
+	if(found_index < 0){
+		RUN_ERROR("[ERR] Function %.*s does not exist\n", (int)name->size, name->str);
+		return -1;
+	}
+	// parsing adds nodes, so it has to go through the real parser and not a copy
+	if(parse_function(ast, &ast->functions[found_index]) != 0){
+		RUN_ERROR("[ERR] Function %.*s has errors in its body\n", (int)name->size, name->str);
+		return -1;
+	}
+
+	int param_count = call->argc-1;
+	if(param_count != (int)ast->functions[found_index].argc){
+		RUN_ERROR("[ERR] Call function needs all parameters required by function being called\n");
+		return -1;
+	}
+	if(collect_params(stack, vars, var_count, &ast->functions[found_index], call) != 0){
+		return -1;
+	}
+	return found_index;
+}
+
+#define PURITY_UNKNOWN -1
+#define PURITY_ASSUMED 2
+
+int expr_is_pure(Parser parser, int* pure, Expr expr){
+	if(NODE(&parser, expr)->type != FUNCTION_CALL){
+		return 1;
+	}
+	struct Expr_Function_Call view = call_of(&parser, expr);
+	struct Expr_Function_Call* call = &view;
+	switch(call->type){
+		case VAR: case FOR: case WHILE: case IF: case ELSE: case ELIF: case END: case RETURN: break;
+		case CALL:
+		{
+			if(call->argc < 1 || NODE(ast, call->argv[0])->type != LITERAL){
+				return 0;
+			}
+			int index = find_function(parser, NODE(ast, call->argv[0])->as.literal);
+			if(index < 0 || !pure[index]){
+				return 0;
+			}
+			break;
+		}
+		// print, read, exit and anything added later talk to the outside world
+		default: return 0;
+	}
+	for(size_t i = 0; i < call->argc; i++){
+		if(!expr_is_pure(parser, pure, call->argv[i])){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// queues every function expr calls that hasn't been looked at yet
+void queue_callees(Parser parser, int* pure, Expr expr, int* queue, size_t* queue_size){
+	if(NODE(&parser, expr)->type != FUNCTION_CALL){
+		return;
+	}
+	struct Expr_Function_Call view = call_of(&parser, expr);
+	struct Expr_Function_Call* call = &view;
+	if(call->type == CALL && call->argc >= 1 && NODE(ast, call->argv[0])->type == LITERAL){
+		int index = find_function(parser, NODE(ast, call->argv[0])->as.literal);
+		if(index >= 0 && pure[index] == PURITY_UNKNOWN){
+			pure[index] = PURITY_ASSUMED;
+			queue[*queue_size] = index;
+			*queue_size = (*queue_size) + 1;
+		}
+	}
+	for(size_t i = 0; i < call->argc; i++){
+		queue_callees(parser, pure, call->argv[i], queue, queue_size);
+	}
+}
+
+// functions only ever see their own vars, so a function is pure as long as it does no
+// io and only calls pure functions. this is worked out the first time a function's
+// value is used, over just the functions it can reach: they all start out assumed pure
+// and get knocked out until nothing changes (which keeps recursive functions pure)
+int function_is_pure(Parser parser, int* pure, int index){
+	if(pure[index] != PURITY_UNKNOWN){
+		return pure[index] != 0;
+	}
+	int* queue = mem_alloc(sizeof(int)*parser.function_count);
+	size_t queue_size = 1;
+	queue[0] = index;
+	pure[index] = PURITY_ASSUMED;
+	for(size_t i = 0; i < queue_size; i++){
+		Function* function = &parser.functions[queue[i]];
+		if(parse_function(ast, function) != 0){
+			pure[queue[i]] = 0;
+			continue;
+		}
+		for(size_t j = 0; j < function->size; j++){
+			queue_callees(parser, pure, function->exprs[j], queue, &queue_size);
+		}
+	}
+
+	int changed = 1;
+	while(changed){
+		changed = 0;
+		for(size_t i = 0; i < queue_size; i++){
+			Function* function = &parser.functions[queue[i]];
+			if(pure[queue[i]] != PURITY_ASSUMED){
+				continue;
+			}
+			for(size_t j = 0; j < function->size; j++){
+				if(!expr_is_pure(parser, pure, function->exprs[j])){
+					pure[queue[i]] = 0;
+					changed = 1;
+					break;
+				}
+			}
+		}
+	}
+	for(size_t i = 0; i < queue_size; i++){
+		if(pure[queue[i]] == PURITY_ASSUMED){
+			pure[queue[i]] = 1;
+		}
+	}
+	mem_free(queue);
+	return pure[index];
+}
+
+size_t hash_bytes(size_t hash, const char* bytes, size_t size){
+	for(size_t i = 0; i < size; i++){
+		hash ^= (unsigned char)bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+// the argument values laid out back to back (type, size, then the string)
+// NULL when one is a map, calls with a map aren't cached
+char* make_memo_key(Var* params, size_t param_count, size_t* key_size){
+	size_t size = 0;
+	for(size_t i = 0; i < param_count; i++){
+		if(params[i].type == MAP){
+			return NULL;
+		}
+		size += 1 + sizeof(size_t) + params[i].str_size;
+	}
+	char* key = mem_alloc(size+1);
+	size_t offset = 0;
+	for(size_t i = 0; i < param_count; i++){
+		key[offset] = (char)params[i].type;
+		memcpy(key+offset+1, &params[i].str_size, sizeof(size_t));
+		memcpy(key+offset+1+sizeof(size_t), params[i].str, params[i].str_size);
+		offset += 1 + sizeof(size_t) + params[i].str_size;
+	}
+	*key_size = size;
+	return key;
+}
+
+Memo_Entry* find_memo(Memo_Entry* memo, int function, char* key, size_t key_size, size_t* hash){
+	*hash = hash_bytes(14695981039346656037ULL ^ (size_t)function, key, key_size);
+	if(memo == NULL){
+		return NULL;
+	}
+	Memo_Entry* entry = &memo[*hash % MEMO_SLOTS];
+	if(entry->key != NULL && entry->function == function && entry->key_size == key_size && memcmp(entry->key, key, key_size) == 0){
+		return entry;
+	}
+	return NULL;
+}
+
+void store_memo(Memo_Entry** memo, Frame* frame, Var value){
+	if(*memo == NULL){
+		*memo = mem_calloc(MEMO_SLOTS, sizeof(Memo_Entry));
+	}
+	Memo_Entry* entry = &(*memo)[frame->memo_hash % MEMO_SLOTS];
+	mem_free(entry->key);
+	mem_free(entry->value.str);
+	// the table is bounded, whatever was in the slot gets replaced
+	entry->key = frame->memo_key;
+	entry->key_size = frame->memo_key_size;
+	entry->function = frame->memo_function;
+	entry->value.type = value.type;
+	entry->value.str_size = value.str_size;
+	entry->value.str = mem_alloc(sizeof(char)*(value.str_size+1));
+	memcpy(entry->value.str, value.str, value.str_size+1);
+	frame->memo_key = NULL;
+}
+
+// pops a finished frame, handing its return value to the var waiting for it
+void return_from_frame(Frame_Stack* stack, Memo_Entry** memo){
+	Frame* frame = &stack->frames[stack->depth-1];
+	Token* return_name = frame->return_name;
+	if(frame->memo_key != NULL && stack->has_returned){
+		store_memo(memo, frame, stack->returned);
+	}
+	pop_frame(stack);
+
+	if(return_name == NULL || stack->depth == 0){
+		if(stack->has_returned){
+			free_var(&stack->returned);
+			stack->has_returned = 0;
+		}
+		return;
+	}
+	if(!stack->has_returned){
+		RUN_ERROR("[ERR] Function did not return a value for %.*s\n", (int)return_name->size, return_name->str);
+		return;
+	}
+	Frame* caller = &stack->frames[stack->depth-1];
+	assign_var(&caller->vars, &caller->var_count, &caller->var_cap, return_name, stack->returned);
+	stack->has_returned = 0;
+}
+
+int looks_like_int(char* str, size_t size){
+	size_t start = (size > 1 && str[0] == '-') ? 1 : 0;
+	if(size == start){
+		return 0;
+	}
+	for(size_t i = start; i < size; i++){
+		if(str[i] < '0' || str[i] > '9'){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+Var* find_or_add_var(Var** vars, size_t* var_count, size_t* var_cap, char* name, size_t name_size){
+	int index = find_var_index(vars, *var_count, name, name_size);
+	if(index >= 0){
+		return &(*vars)[index];
+	}
+	Var var = {0};
+	var.name = mem_alloc(sizeof(char)*(name_size+1));
+	memcpy(var.name, name, name_size);
+	var.name[name_size] = '\0';
+	var.name_size = name_size;
+	add_var(vars, var_count, var_cap, var);
+	return &(*vars)[(*var_count)-1];
+}
+
+// the var points straight into a record or another string, it only gets copied if the program changes it
+void bind_view(Var** vars, size_t* var_count, size_t* var_cap, char* name, size_t name_size, char* str, size_t str_size){
+	Var* var = find_or_add_var(vars, var_count, var_cap, name, name_size);
+	release_str(var);
+	if(var->rope != NULL){
+		free_rope(var->rope);
+		var->rope = NULL;
+	}
+	var->type = looks_like_int(str, str_size) ? INTEGER : STRING;
+	var->str = str;
+	var->str_size = str_size;
+	var->borrowed = 1;
+}
+
+// reads the next line for -n and sets line, nr, nf and f1 to fN, returns 0 at the end of input
+int bind_record(Frame* frame, Record_Reader* records, size_t* bound_fields){
+	if(!next_record(records)){
+		return 0;
+	}
+	bind_view(&frame->vars, &frame->var_count, &frame->var_cap, "line", 4, records->line, records->line_size);
+	set_var_int(find_or_add_var(&frame->vars, &frame->var_count, &frame->var_cap, "nr", 2), records->number);
+	set_var_int(find_or_add_var(&frame->vars, &frame->var_count, &frame->var_cap, "nf", 2), records->field_count);
+	char name[32];
+	for(size_t i = 0; i < records->field_count; i++){
+		int name_size = snprintf(name, sizeof(name), "f%zu", i+1);
+		bind_view(&frame->vars, &frame->var_count, &frame->var_cap, name, name_size, records->fields[i], records->field_sizes[i]);
+	}
+	// fields past the end of a shorter line are 0 rather than left over, same as a var never set
+	// so `total (total + f3)` keeps working on a line with two fields
+	for(size_t i = records->field_count; i < *bound_fields; i++){
+		int name_size = snprintf(name, sizeof(name), "f%zu", i+1);
+		bind_view(&frame->vars, &frame->var_count, &frame->var_cap, name, name_size, "0", 1);
+	}
+	if(records->field_count > *bound_fields){
+		*bound_fields = records->field_count;
+	}
+	return 1;
+}
+
+// binds the line of source starting at start to name, 0 once there are no lines left
+int bind_next_line(Var** vars, size_t* var_count, size_t* var_cap, Token* name, Var* source, char* start){
+	char* end = source->str+source->str_size;
+	if(start >= end){
+		return 0;
+	}
+	char* newline = find_newline(start, end);
+	size_t line_size = (newline != NULL ? newline : end)-start;
+	if(line_size > 0 && start[line_size-1] == '\r'){
+		line_size--;
+	}
+	bind_view(vars, var_count, var_cap, name->str, name->size, start, line_size);
+	return 1;
+}
+
+// `each line text` hands out the lines of text one at a time as views, none of them get copied
+// (`each key m` hands out the keys of a map in the order they went in)
+// returns the source var (flattened) or NULL if the loop can't run
+Var* each_source(Var** vars, size_t var_count, struct Expr_Function_Call* call){
+	if(call->argc != 2 || NODE(ast, call->argv[0])->type != LITERAL || NODE(ast, call->argv[0])->as.literal->type != IDENTIFIER
+	|| NODE(ast, call->argv[1])->type != LITERAL || NODE(ast, call->argv[1])->as.literal->type != IDENTIFIER){
+		RUN_ERROR("[ERR] Each requires a var for the line and a var holding the text\n");
+		return NULL;
+	}
+	Token* source_name = NODE(ast, call->argv[1])->as.literal;
+	int index = find_var_index(vars, var_count, source_name->str, source_name->size);
+	if(index >= 0 && (*vars)[index].type == MAP){
+		return &(*vars)[index];
+	}
+	if(find_var(vars, var_count, source_name->str, source_name->size).str == NULL){
+		RUN_ERROR("[ERR] Cannot find variable %.*s\n", (int)source_name->size, source_name->str);
+		return NULL;
+	}
+	return &(*vars)[find_var_index(vars, var_count, source_name->str, source_name->size)];
+}
+
+// prints every arg after start the way print does, then the newline
+void write_args(FILE* out, Var** vars, size_t size, struct Expr_Function_Call* call, size_t start){
+	for(size_t j = start; j < call->argc; j++){
+		Expr arg = call->argv[j];
+		if(is_string_join(vars, size, arg)){
+			print_string_join(out, vars, size, arg);
+			continue;
+		}
+		Node* node = NODE(ast, arg);
+		switch(node->type){
+			case OPERATION: fprintf(out, "%d", solve_int_expr(vars, size, arg)); break;
+			case LITERAL:
+			{
+				if(node->as.literal->type != IDENTIFIER){
+					fprintf(out, "%s", node->as.literal->str);
+					break;
+				}
+				int index = find_var_index(vars, size, node->as.literal->str, node->as.literal->size);
+				if(index >= 0 && (*vars)[index].map != NULL){
+					print_map(out, (*vars)[index].map);
+				}
+				else if(index >= 0 && (*vars)[index].rope != NULL){
+					rope_write((*vars)[index].rope, out);
+				}
+				else if(index >= 0){
+					fwrite((*vars)[index].str, sizeof(char), (*vars)[index].str_size, out);
+				}
+				break;
+			}
+			case GROUPED:
+			{
+				Node* inner = NODE(ast, node->as.grouped);
+				if(inner->type == OPERATION){
+					fprintf(out, "%d", solve_int_expr(vars, size, node->as.grouped));
+				}
+				else if(inner->type == LITERAL){
+					fprintf(out, "%s", inner->as.literal->str);
+				}
+				break;
+			}
+			default: break;
+		}
+	}
+	fprintf(out, "\n");
+}
+
+// a statement list gets optimized right before it first runs, then its blocks are matched
+size_t* prepare_statements(char* name, Expr** exprs, size_t* size, size_t* capacity){
+	size_t* blocks = match_blocks(*exprs, *size);
+	if(optimize_statements(ast, exprs, size, capacity, blocks, dump_optimized) == 0){
+		return blocks;
+	}
+	mem_free(blocks);
+	if(dump_optimized){
+		printf("--Optimized %s--\n", name);
+		print_statements(ast, *exprs, *size);
+	}
+	return match_blocks(*exprs, *size);
+}
+
+// the stdlib can change under a program between builds, so the functions it was linked with count too
+size_t hash_source(char* src, size_t size, Parser* parser){
+	size_t hash = hash_bytes(14695981039346656037ULL, src, size);
+	for(size_t i = 0; i < parser->function_count; i++){
+		Function* function = &parser->functions[i];
+		hash = hash_bytes(hash, function->name, function->name_size);
+		for(size_t j = 0; j < function->body_size; j++){
+			hash = hash_bytes(hash, function->body[j].str, function->body[j].size+1);
+		}
+	}
+	return hash;
+}
+
+// picks up from the last `snapshot "path"` in the program that has a snapshot saved by this
+// same source, everything above it is skipped
+void restore_run(Run* run, Frame* top, int debug_mode){
+	for(size_t i = top->size; i > 0; i--){
+		Node* node = NODE(ast, top->exprs[i-1]);
+		if(node->type != FUNCTION_CALL){
+			continue;
+		}
+		struct Expr_Function_Call call = call_of(ast, top->exprs[i-1]);
+		if(call.type != SNAPSHOT || call.argc != 1
+		|| NODE(ast, call.argv[0])->type != LITERAL
+		|| NODE(ast, call.argv[0])->as.literal->type != STRING){
+			continue;
+		}
+		Snapshot snapshot;
+		if(open_snapshot(NODE(ast, call.argv[0])->as.literal->str, run->source_hash, i, &snapshot) != 0){
+			continue;
+		}
+		if(restore_snapshot(&snapshot, &top->vars, &top->var_count, &top->var_cap, &run->memo) != 0){
+			close_snapshot(&snapshot);
+			continue;
+		}
+		top->pc = i;
+		run->snapshot = snapshot.data;
+		run->snapshot_size = snapshot.size;
+		if(debug_mode == 0){
+			printf("[DEBG] Restored %zu vars from %s\n", top->var_count, NODE(ast, call.argv[0])->as.literal->str);
+		}
+		return;
+	}
+}
+
+// what a run says when one of its allocations was refused, see refuse_over_limit
+void report_refused(Run* run){
+	if(run->memory->over_limit){
+		RUN_ERROR("[ERR] Went past the memory limit of %zu bytes\n", run->memory->limit);
+	}
+	else{
+		RUN_ERROR("[ERR] Ran out of memory\n");
+	}
+}
+
+// everything start_run does once the run has its memory
+int load_run(Run* run, char* src, size_t size, int debug_mode, int per_line){
+	run->lexer = lex(src, size);
+	if(debug_mode == 0){
+		print_lexer(run->lexer);
+	}
+	if(run->lexer.exit_code != 0){
+		printf("[INFO] Lexer had error, stopping here\n");
+		run->exit_code = run->lexer.exit_code;
+		run->done = 1;
+		return run->exit_code;
+	}
+
+	run->parser = parse(run->lexer);
+	if(debug_mode == 0){
+		print_parser(run->parser);
+	}
+	if(run->parser.exit_code != 0){
+		printf("[INFO] Parser had error, stopping here\n");
+		run->exit_code = run->parser.exit_code;
+		run->done = 1;
+		return run->exit_code;
+	}
+
+	size_t linked = link_std(&run->parser, run->lexer);
+	if(debug_mode == 0 && linked > 0){
+		printf("[DEBG] Linked %zu stdlib functions\n", linked);
+	}
+	prune_functions(&run->parser, debug_mode == 0);
+	ast = &run->parser;
+	jit_cache = &run->jit;
+	trace_start();
+
+	Parser* parser = &run->parser;
+	run->stack = new_frame_stack(max_frames);
+	dump_optimized = debug_mode == 0;
+	run->program_blocks = prepare_statements("Global", &parser->exprs, &parser->size, &parser->capacity);
+	run->function_blocks = mem_calloc(parser->function_count+1, sizeof(size_t*));
+	run->pure = mem_alloc(sizeof(int)*(parser->function_count+1));
+	for(size_t i = 0; i < parser->function_count; i++){
+		run->pure[i] = PURITY_UNKNOWN;
+	}
+	run->job_count = 0;
+	run->job_capacity = 8;
+	run->jobs = mem_alloc(run->job_capacity*sizeof(Shell_Job));
+	run->writers = new_writer_table();
+	run->out = stdout;
+
+	Frame* top = push_frame(&run->stack);
+	top->exprs = parser->exprs;
+	top->size = parser->size;
+	top->blocks = run->program_blocks;
+	run->per_line = per_line;
+	if(per_line){
+		run->records = new_record_reader(0);
+		if(!bind_record(top, &run->records, &run->bound_fields)){
+			top->pc = top->size;
+		}
+	}
+	else{
+		run->source_hash = hash_source(src, size, parser);
+		restore_run(run, top, debug_mode);
+	}
+	return 0;
+}
+
+int start_run(Run* run, char* src, size_t size, int debug_mode, int per_line, Allocator* allocator, size_t memory_limit){
+	memset(run, 0, sizeof(Run));
+	run->memory = new_memory(allocator, memory_limit);
+	use_memory(run->memory);
+	int res = 1;
+	jmp_buf refused;
+	jmp_buf* outer = refuse_over_limit(&refused);
+	if(setjmp(refused) == 0){
+		res = load_run(run, src, size, debug_mode, per_line);
+		refuse_over_limit(outer);
+	}
+	else{
+		refuse_over_limit(outer);
+		report_refused(run);
+		run->exit_code = 1;
+		run->done = 1;
+		res = 1;
+	}
+	return res;
+}
+
+// the shell jobs and files a finished (or aborted) run still has going
+void finish_run(Run* run){
+	// nothing waited on these, they still get reaped so they don't linger
+	shell_wait_all(run->jobs, run->job_count);
+	for(size_t i = 0; i < run->job_count; i++){
+		mem_free(run->jobs[i].out);
+	}
+	run->job_count = 0;
+	close_writers(&run->writers);
+	run->done = 1;
+}
+
+#define PFOR_RAN 0
+#define PFOR_REJECTED 1
+#define PFOR_FAILED 2
+// the fuel ran out partway through, the iterations that finished are done and the rest run next slice
+#define PFOR_YIELDED 3
+// iterations a pfor runs before writing out what they printed, so a long loop never holds
+// more output (or bookkeeping) than this many iterations' worth
+#define PFOR_CHUNK 1024
+int run_pfor(Run* run, Var* vars, size_t var_count, Expr* exprs, size_t pfor_index, size_t end_index, int start, int limit, size_t fuel, size_t* used, size_t* finished);
+
+// the loop works on these, whatever it changes goes back into the run when the slice ends
+enum Run_Status eval_loop(Run* run, size_t fuel){
+	Parser parser = run->parser;
+	Record_Reader* records = run->per_line ? &run->records : NULL;
+	int exit_code = 0;
+	Frame_Stack stack = run->stack;
+	size_t** function_blocks = run->function_blocks;
+	int* pure = run->pure;
+	Memo_Entry* memo = run->memo;
+	size_t bound_fields = run->bound_fields;
+	size_t ran = 0;
+	enum Run_Status status = RUN_DONE;
+	FILE* out = run->out;
+	// pfor workers don't touch the ring, it belongs to the main thread
+	Trace_Entry untraced = {0};
+
+	while(stack.depth > 0){
+		Frame* frame = &stack.frames[stack.depth-1];
+		if(frame->pc >= frame->size){
+			// top level vars carry over from one line to the next, like awk
+			if(records != NULL && stack.depth == 1 && bind_record(frame, records, &bound_fields)){
+				frame->pc = 0;
+				continue;
+			}
+			// a pfor iteration's frame gets reused by the next iteration, see run_pfor
+			if(run->worker && stack.depth == 1){
+				break;
+			}
+			return_from_frame(&stack, &memo);
+			continue;
+		}
+		// only ever stops between statements, so picking back up is just running the loop again
+		if(fuel > 0 && ran >= fuel){
+			status = RUN_YIELDED;
+			break;
+		}
+		ran++;
+
+		Expr* exprs = frame->exprs;
+		size_t size = frame->size;
+		size_t* blocks = frame->blocks;
+		Var* vars = frame->vars;
+		size_t var_count = frame->var_count;
+		size_t var_cap = frame->var_cap;
+		size_t i = frame->pc;
+		int call_index = -1;
+		Token* return_name = NULL;
+		int tail_call = 0;
+
+		Expr expr = exprs[i];
+		switch(NODE(ast, expr)->type){
+			case FUNCTION_CALL:
+			{
+				struct Expr_Function_Call call = call_of(ast, expr);
+				Token* first = NULL;
+				if(call.argc > 0 && NODE(ast, call.argv[0])->type == LITERAL){
+					first = NODE(ast, call.argv[0])->as.literal;
+				}
+				Trace_Entry* traced = run->worker ? &untraced : trace_statement(NODE(ast, expr)->line, call.type, first);
+				switch(call.type){
+					case CALL:
+					{
+						call_index = prepare_call(&stack, &vars, var_count, &call);
+						break;
+					}
+					case FOR:
+					{
+						if(call.argc != 2
+						|| NODE(ast, call.argv[0])->type != LITERAL
+						|| NODE(ast, call.argv[0])->as.literal->type != IDENTIFIER){
+							RUN_ERROR("[ERR] For loop requires a var and the number to count up to\n");
+							break;
+						}
+						if(blocks[i] >= size){
+							RUN_ERROR("[ERR] For loop is missing its end\n");
+							break;
+						}
+						size_t next = 0;
+						if(jit_enabled && run_jit_loop(&vars, var_count, exprs, i, blocks[i], &next)){
+							if(next < blocks[i]){
+								// picking up partway through the body, its end closes a scope like any other time round
+								open_scope(frame, var_count);
+							}
+							i = next;
+							break;
+						}
+
+						Token* counter = NODE(ast, call.argv[0])->as.literal;
+						// looked up by index since -n hands back 0 for vars that don't exist
+						int index = find_var_index(&vars, var_count, counter->str, counter->size);
+						if(index < 0 || vars[index].type != INTEGER){
+							RUN_ERROR("[ERR] For loop var %.*s has to be an integer made before the loop\n", (int)counter->size, counter->str);
+							i = blocks[i];
+							break;
+						}
+						if(atoi(vars[index].str) >= solve_int_expr(&vars, var_count, call.argv[1])){
+							i = blocks[i];
+							break;
+						}
+						open_scope(frame, var_count);
+						break;
+					}
+					case END:
+					{
+						size_t start = blocks[i];
+						struct Expr_Function_Call opener = {0};
+						if(start < size){
+							opener = call_of(ast, exprs[start]);
+						}
+						if(start < size && opener.type == EACH){
+							struct Expr_Function_Call* each = &opener;
+							Var* source = each_source(&vars, var_count, each);
+							Token* name = NODE(ast, each->argv[0])->as.literal;
+							int index = find_var_index(&vars, var_count, name->str, name->size);
+							if(source == NULL){
+								break;
+							}
+							if(source->type == MAP){
+								// the key var says where it got to, so putting and deleting other keys is fine
+								Map* map = source->map;
+								Map_Entry* entry = NULL;
+								if(index >= 0 && vars[index].str != NULL){
+									entry = map_get(map, vars[index].type, vars[index].str, vars[index].str_size);
+								}
+								if(entry == NULL){
+									RUN_ERROR("[ERR] Each var %.*s was changed (or its key deleted) inside the loop\n", (int)name->size, name->str);
+									break;
+								}
+								size_t next = map_next(map, entry-map->entries+1);
+								close_scope(frame, vars, &var_count);
+								size_t mark = var_count;
+								if(next < map->entry_count){
+									bind_map_key(&vars, &var_count, &var_cap, name, &map->entries[next]);
+									open_scope(frame, mark);
+									i = start;
+								}
+								break;
+							}
+							// the line var is still a view into the source, the next line starts after it
+							// the whole view has to be in there, not just its start
+							char* end = source->str+source->str_size;
+							if(index < 0 || !vars[index].borrowed || vars[index].str < source->str || vars[index].str > end
+							|| vars[index].str_size > (size_t)(end-vars[index].str)){
+								RUN_ERROR("[ERR] Each var %.*s was changed inside the loop\n", (int)name->size, name->str);
+								break;
+							}
+							char* newline = find_newline(vars[index].str+vars[index].str_size, end);
+							close_scope(frame, vars, &var_count);
+							size_t mark = var_count;
+							if(newline != NULL && bind_next_line(&vars, &var_count, &var_cap, name, source, newline+1)){
+								open_scope(frame, mark);
+								i = start;
+								break;
+							}
+							// the line var was made before the loop, so it outlives the text it points into
+							index = find_var_index(&vars, var_count, name->str, name->size);
+							if(index >= 0){
+								own_str(&vars[index]);
+							}
+							break;
+						}
+						if(start >= size || opener.type != FOR){
+							break;
+						}
+						close_scope(frame, vars, &var_count);
+						Token* counter = NODE(ast, opener.argv[0])->as.literal;
+						int index = find_var_index(&vars, var_count, counter->str, counter->size);
+						if(index >= 0 && vars[index].type == INTEGER){
+							set_var_int(&vars[index], atoi(vars[index].str)+1);
+						}
+						// back to the for, which checks if it should go again
+						i = start-1;
+						break;
+					}
+					case SH:
+					{
+						run_command(&vars, var_count, &call, 0, NULL);
+						break;
+					}
+					case PUT:
+					{
+						if(call.argc != 3){
+							RUN_ERROR("[ERR] Put requires the map, the key and the value\n");
+							break;
+						}
+						Var* map = find_map(&vars, var_count, call.argv[0], "Put");
+						if(map == NULL){
+							break;
+						}
+						Var key = {0};
+						Var value = {0};
+						if(solve_key(&vars, var_count, call.argv[1], &key) != 0){
+							break;
+						}
+						if(solve_value(&vars, var_count, call.argv[2], &value) != 0){
+							mem_free(key.str);
+							break;
+						}
+						trace_value(traced, value.str, value.str_size);
+						own_str(map);
+						map_set(map->map, key.type, key.str, key.str_size, value.type, value.str, value.str_size);
+						break;
+					}
+					case DELETE:
+					{
+						if(call.argc != 2){
+							RUN_ERROR("[ERR] Delete requires the map and the key\n");
+							break;
+						}
+						Var* map = find_map(&vars, var_count, call.argv[0], "Delete");
+						Var key = {0};
+						if(map == NULL || solve_key(&vars, var_count, call.argv[1], &key) != 0){
+							break;
+						}
+						own_str(map);
+						map_delete(map->map, key.type, key.str, key.str_size);
+						mem_free(key.str);
+						break;
+					}
+					case SPAWN:
+					{
+						if(call.argc < 2
+						|| NODE(ast, call.argv[0])->type != LITERAL
+						|| NODE(ast, call.argv[0])->as.literal->type != IDENTIFIER){
+							RUN_ERROR("[ERR] Spawn requires the var to put the output in and then the command\n");
+							break;
+						}
+						char* command = build_command(&vars, var_count, &call, 1);
+						if(command == NULL){
+							break;
+						}
+						// straight in the run, so a refused allocation leaves it knowing every job to reap
+						if(run->job_count >= run->job_capacity){
+							run->jobs = mem_realloc(run->jobs, 2*run->job_capacity*sizeof(Shell_Job));
+							run->job_capacity *= 2;
+						}
+						Shell_Job* job = &run->jobs[run->job_count];
+						if(shell_start(command, 1, job) == 0){
+							job->name = NODE(ast, call.argv[0])->as.literal;
+							run->job_count++;
+						}
+						mem_free(command);
+						break;
+					}
+					case WAIT:
+					{
+						// every spawned command has been running this whole time, this just collects them
+						Shell_Job* jobs = run->jobs;
+						shell_wait_all(jobs, run->job_count);
+						for(size_t j = 0; j < run->job_count; j++){
+							Var value = {0};
+							value.type = STRING;
+							value.str = jobs[j].out;
+							value.str_size = jobs[j].out_size;
+							// the var has it now, finish_run mustn't free it as well
+							jobs[j].out = NULL;
+							assign_var(&vars, &var_count, &var_cap, jobs[j].name, value);
+						}
+						run->job_count = 0;
+						break;
+					}
+					case PRINT:
+					{
+						write_args(out, &vars, var_count, &call, 0);
+						break;
+					}
+					case WRITE:
+					{
+						if(call.argc < 1){
+							RUN_ERROR("[ERR] Write requires the path of the file to write to\n");
+							break;
+						}
+						Var path = {0};
+						if(solve_value(&vars, var_count, call.argv[0], &path) != 0){
+							break;
+						}
+						FILE* file = open_writer(&run->writers, path.str);
+						if(file != NULL){
+							write_args(file, &vars, var_count, &call, 1);
+						}
+						mem_free(path.str);
+						break;
+					}
+					case SNAPSHOT:
+					{
+						if(call.argc != 1
+						|| NODE(ast, call.argv[0])->type != LITERAL
+						|| NODE(ast, call.argv[0])->as.literal->type != STRING){
+							RUN_ERROR("[ERR] Snapshot requires the path to save to as a string\n");
+							break;
+						}
+						// restoring only ever puts vars back in the top frame, so nothing else can be going on
+						if(stack.depth != 1 || frame->scope_count != 0 || records != NULL){
+							RUN_ERROR("[ERR] Snapshot can only be taken at the top level, outside of loops and -n\n");
+							break;
+						}
+						if(run->job_count != 0){
+							RUN_ERROR("[ERR] Snapshot can't be taken while spawned commands haven't been waited on\n");
+							break;
+						}
+						int has_map = 0;
+						for(size_t v = 0; v < var_count; v++){
+							find_var(&vars, var_count, vars[v].name, vars[v].name_size);
+							if(vars[v].type == MAP && !has_map){
+								RUN_ERROR("[ERR] Snapshot can't save maps yet, %s is one\n", vars[v].name);
+								has_map = 1;
+							}
+						}
+						if(has_map){
+							break;
+						}
+						char* path = NODE(ast, call.argv[0])->as.literal->str;
+						save_snapshot(path, run->source_hash, i+1, vars, var_count, memo);
+						break;
+					}
+					case PFOR:
+					{
+						if(call.argc != 2
+						|| NODE(ast, call.argv[0])->type != LITERAL
+						|| NODE(ast, call.argv[0])->as.literal->type != IDENTIFIER){
+							RUN_ERROR("[ERR] Pfor loop requires a var and the number to count up to\n");
+							break;
+						}
+						if(blocks[i] >= size){
+							RUN_ERROR("[ERR] Pfor loop is missing its end\n");
+							break;
+						}
+						Token* counter = NODE(ast, call.argv[0])->as.literal;
+						int index = find_var_index(&vars, var_count, counter->str, counter->size);
+						if(index < 0 || vars[index].type != INTEGER){
+							RUN_ERROR("[ERR] Pfor loop var %.*s has to be an integer made before the loop\n", (int)counter->size, counter->str);
+							i = blocks[i];
+							break;
+						}
+						int start = atoi(vars[index].str);
+						int limit = solve_int_expr(&vars, var_count, call.argv[1]);
+						if(start < limit){
+							// the iterations get whatever fuel the slice has left, see run_pfor
+							int first_in_slice = ran == 1;
+							size_t used = 0;
+							size_t finished = 0;
+							int res = PFOR_YIELDED;
+							if(fuel == 0 || ran < fuel){
+								res = run_pfor(run, vars, var_count, exprs, i, blocks[i], start, limit, fuel > 0 ? fuel-ran : 0, &used, &finished);
+							}
+							ran += used;
+							if(res == PFOR_YIELDED && finished == 0 && first_in_slice){
+								// it had the whole slice and still couldn't finish one, another slice won't help
+								RUN_ERROR("[ERR] A pfor iteration needs more than the %zu statements of fuel a slice has\n", fuel);
+								res = PFOR_FAILED;
+							}
+							if(res == PFOR_YIELDED){
+								// the iterations that finished are done with, the rest start over next slice
+								set_var_int(&vars[index], start+(int)finished);
+								ran = fuel;
+								i--;
+								break;
+							}
+							if(res != PFOR_REJECTED){
+								// same as for, the var is left at what it counted up to
+								set_var_int(&vars[index], limit);
+							}
+							if(res == PFOR_FAILED){
+								exit_code = 1;
+							}
+						}
+						i = blocks[i];
+						break;
+					}
+					case EACH:
+					{
+						if(blocks[i] >= size){
+							RUN_ERROR("[ERR] Each loop is missing its end\n");
+							break;
+						}
+						Var* source = each_source(&vars, var_count, &call);
+						size_t mark = var_count;
+						if(source != NULL && source->type == MAP){
+							Map* map = source->map;
+							size_t first = map_next(map, 0);
+							if(first >= map->entry_count){
+								i = blocks[i];
+								break;
+							}
+							bind_map_key(&vars, &var_count, &var_cap, NODE(ast, call.argv[0])->as.literal, &map->entries[first]);
+							open_scope(frame, mark);
+							break;
+						}
+						if(source == NULL || !bind_next_line(&vars, &var_count, &var_cap, NODE(ast, call.argv[0])->as.literal, source, source->str)){
+							i = blocks[i];
+							break;
+						}
+						open_scope(frame, mark);
+						break;
+					}
+					case VAR:
+					{
+						if(call.argc != 2){
+							RUN_ERROR("[ERR] Var call requires 2 args, the variable and the value\n");
+							break;
+						}
+						if(NODE(ast, call.argv[0])->type != LITERAL){
+first_arg_name_error:
+							RUN_ERROR("[ERR] Var call requires first arg to be var name\n");
+							break;
+						}
+						Token* name = NODE(ast, call.argv[0])->as.literal;
+						if(name->type != IDENTIFIER){
+							goto first_arg_name_error;
+						}
+
+						Expr arg2 = call.argv[1];
+						struct Expr_Function_Call inner = {0};
+						if(NODE(ast, arg2)->type == FUNCTION_CALL){
+							inner = call_of(ast, arg2);
+						}
+						if(is_string_join(&vars, var_count, arg2)){
+							set_string_join(&vars, &var_count, &var_cap, name, arg2);
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL && inner.type == CALL){
+							call_index = prepare_call(&stack, &vars, var_count, &inner);
+							return_name = name;
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL && inner.type == SH){
+							Var value = {0};
+							if(run_command(&vars, var_count, &inner, 1, &value) == 0){
+								assign_var(&vars, &var_count, &var_cap, name, value);
+							}
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL && inner.type == LOAD){
+							Var value = {0};
+							if(load_file(&vars, var_count, &inner, &value) == 0){
+								assign_var(&vars, &var_count, &var_cap, name, value);
+							}
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL && inner.type == MAP){
+							Var value = {0};
+							if(make_map(&vars, var_count, &inner, &value) == 0){
+								assign_var(&vars, &var_count, &var_cap, name, value);
+							}
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL && (inner.type == GET || inner.type == HAS)){
+							Var value = {0};
+							if(read_map(&vars, var_count, &inner, &value) == 0){
+								trace_value(traced, value.str, value.str_size);
+								assign_var(&vars, &var_count, &var_cap, name, value);
+							}
+							break;
+						}
+						if(NODE(ast, arg2)->type == FUNCTION_CALL){
+							RUN_ERROR("[ERR] Var call cannot take function calls other than call, sh, load, map, get or has in the arguments\n");
+							break;
+						}
+						Var* source = map_source(&vars, var_count, arg2);
+						if(source != NULL){
+							Var value = {0};
+							value.type = MAP;
+							value.map = copy_map(source->map);
+							assign_var(&vars, &var_count, &var_cap, name, value);
+							break;
+						}
+
+						Var value = {0};
+						if(solve_value(&vars, var_count, arg2, &value) != 0){
+							break;
+						}
+						if(value.str != NULL){
+							trace_value(traced, value.str, value.str_size);
+						}
+						assign_var(&vars, &var_count, &var_cap, name, value);
+						break;
+					}
+					case RETURN:
+					{
+						if(stack.depth <= 1){
+							RUN_ERROR("[ERR] Return has to be inside a function\n");
+							break;
+						}
+						if(call.argc != 1){
+							RUN_ERROR("[ERR] Return requires exactly one value\n");
+							break;
+						}
+						Expr arg = call.argv[0];
+						if(NODE(ast, arg)->type == FUNCTION_CALL && call_of(ast, arg).type == CALL){
+							struct Expr_Function_Call inner = call_of(ast, arg);
+							// `return call f x` hands this frame over to f
+							call_index = prepare_call(&stack, &vars, var_count, &inner);
+							tail_call = 1;
+							break;
+						}
+						Var value = {0};
+						Var* source = map_source(&vars, var_count, arg);
+						if(source != NULL){
+							value.type = MAP;
+							value.map = copy_map(source->map);
+						}
+						else if(solve_value(&vars, var_count, arg, &value) != 0){
+							break;
+						}
+						if(stack.has_returned){
+							free_var(&stack.returned);
+						}
+						stack.returned = value;
+						stack.has_returned = 1;
+						i = size;
+						break;
+					}
+					default: break;
+				}
+				break;
+			}
+			case TEMP:
+			{
+				set_temp(&vars, &var_count, &var_cap, NODE(ast, expr));
+				break;
+			}
+			default: break;
+		}
+
+		frame->vars = vars;
+		frame->var_count = var_count;
+		frame->var_cap = var_cap;
+		frame->pc = i+1;
+		// an allocation refused in a pfor iteration stops the run once the loop is over (and the
+		// other iterations at their next statement), the main thread's own never get back here
+		if(run->memory->refused){
+			if(!run->worker){
+				report_refused(run);
+			}
+			exit_code = 1;
+		}
+		// a pfor iteration that went past the frame limit stops everything, same as it would here
+		if(exit_code != 0){
+			break;
+		}
+		if(call_index < 0){
+			continue;
+		}
+
+		Function* function = &parser.functions[call_index];
+		char* memo_key = NULL;
+		size_t memo_key_size = 0;
+		size_t memo_hash = 0;
+		if(return_name != NULL && function_is_pure(parser, pure, call_index)){
+			memo_key = make_memo_key(stack.params, stack.param_count, &memo_key_size);
+			Memo_Entry* entry = NULL;
+			if(memo_key != NULL){
+				entry = find_memo(memo, call_index, memo_key, memo_key_size, &memo_hash);
+			}
+			if(entry != NULL){
+				Var value = entry->value;
+				value.str = mem_alloc(sizeof(char)*(value.str_size+1));
+				memcpy(value.str, entry->value.str, value.str_size+1);
+				assign_var(&frame->vars, &frame->var_count, &frame->var_cap, return_name, value);
+				mem_free(memo_key);
+				drop_params(&stack);
+				continue;
+			}
+		}
+		if(function_blocks[call_index] == NULL){
+			function_blocks[call_index] = prepare_statements(function->name, &function->exprs, &function->size, &function->capacity);
+		}
+		if(return_name == NULL && stack.depth > 1 && (tail_call || frame->pc >= frame->size)){
+			// tail call, nothing is left to run in this frame so the callee takes it over
+			// along with where its value goes
+			clear_frame_vars(frame);
+		}
+		else{
+			if(stack.depth >= stack.max_depth){
+				RUN_ERROR("[ERR] Calling %.*s went past the limit of %zu frames\n", (int)function->name_size, function->name, stack.max_depth);
+				mem_free(memo_key);
+				exit_code = 1;
+				break;
+			}
+			frame = push_frame(&stack);
+			frame->return_name = return_name;
+			frame->memo_key = memo_key;
+			frame->memo_key_size = memo_key_size;
+			frame->memo_hash = memo_hash;
+			frame->memo_function = call_index;
+		}
+		frame->exprs = function->exprs;
+		frame->size = function->size;
+		frame->blocks = function_blocks[call_index];
+		frame->pc = 0;
+		bind_params(&stack, frame);
+	}
+
+	run->stack = stack;
+	run->memo = memo;
+	run->bound_fields = bound_fields;
+	run->statements += ran;
+	if(status == RUN_YIELDED){
+		return status;
+	}
+	run->exit_code = exit_code;
+	return exit_code == 0 ? RUN_DONE : RUN_FAILED;
+}
+
+// pfor iterations run on other threads, so neither they nor any function they can reach may do
+// something that races the other iterations or the code around the loop
+int pfor_safe_expr(Expr expr, int* seen, int* queue, size_t* queue_size){
+	if(NODE(ast, expr)->type != FUNCTION_CALL){
+		return 1;
+	}
+	struct Expr_Function_Call call = call_of(ast, expr);
+	switch(call.type){
+		case READ: case EXIT: case SH: case SPAWN: case WAIT: case WRITE: case PFOR: case SNAPSHOT: return 0;
+		case CALL:
+		{
+			if(call.argc < 1 || NODE(ast, call.argv[0])->type != LITERAL){
+				break;
+			}
+			int index = find_function(*ast, NODE(ast, call.argv[0])->as.literal);
+			if(index >= 0 && !seen[index]){
+				seen[index] = 1;
+				queue[*queue_size] = index;
+				*queue_size = (*queue_size) + 1;
+			}
+			break;
+		}
+		default: break;
+	}
+	for(size_t i = 0; i < call.argc; i++){
+		if(!pfor_safe_expr(call.argv[i], seen, queue, queue_size)){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+// iterations only get to read the vars from outside the loop, so the body can't set any of them
+// (the loop's own var is the exception, each iteration has its own copy)
+int check_pfor_body(Var* vars, size_t var_count, Expr* body, size_t body_size, Token* counter){
+	int* seen = mem_calloc(ast->function_count+1, sizeof(int));
+	int* queue = mem_alloc(sizeof(int)*(ast->function_count+1));
+	size_t queue_size = 0;
+	int safe = 1;
+	for(size_t i = 0; i < body_size && safe; i++){
+		safe = pfor_safe_expr(body[i], seen, queue, &queue_size);
+		if(!safe || NODE(ast, body[i])->type != FUNCTION_CALL){
+			continue;
+		}
+		struct Expr_Function_Call call = call_of(ast, body[i]);
+		if(call.type == RETURN){
+			RUN_ERROR("[ERR] Return can't be used directly inside a pfor body\n");
+			goto rejected;
+		}
+		if((call.type != VAR && call.type != FOR && call.type != EACH && call.type != PUT && call.type != DELETE)
+		|| call.argc < 1 || NODE(ast, call.argv[0])->type != LITERAL){
+			continue;
+		}
+		Token* name = NODE(ast, call.argv[0])->as.literal;
+		if(name->size == counter->size && strncmp(name->str, counter->str, name->size) == 0){
+			continue;
+		}
+		if(find_var_index(&vars, var_count, name->str, name->size) >= 0){
+			RUN_ERROR("[ERR] Pfor body can't set %.*s, iterations can only read the vars from outside the loop\n", (int)name->size, name->str);
+			goto rejected;
+		}
+	}
+	for(size_t i = 0; i < queue_size && safe; i++){
+		Function* function = &ast->functions[queue[i]];
+		parse_function(ast, function);
+		for(size_t j = 0; j < function->size && safe; j++){
+			safe = pfor_safe_expr(function->exprs[j], seen, queue, &queue_size);
+		}
+	}
+	if(!safe){
+		RUN_ERROR("[ERR] A pfor body and the functions it calls can't use read, exit, sh, spawn, wait, write, snapshot or another pfor\n");
+		goto rejected;
+	}
+	mem_free(seen);
+	mem_free(queue);
+	return 1;
+
+rejected:
+	mem_free(seen);
+	mem_free(queue);
+	return 0;
+}
+
+typedef struct {
+	Run* run;
+	// the vars of the frame the loop is in, iterations see them through borrowed views
+	Var* vars;
+	size_t var_count;
+	Token* counter;
+	Expr* body;
+	size_t body_size;
+	size_t* body_blocks;
+	int start;
+	// where the chunk being run starts, iterations are numbered from it
+	size_t first;
+	// what the slice has left for the iterations (0 for no limit) and how much they took of it
+	size_t fuel;
+	size_t fuel_used;
+	// one per pool thread, set up the first time that thread gets an iteration
+	Run* workers;
+	// what each iteration of the chunk printed, written out in order once it is done
+	char** outputs;
+	size_t* output_sizes;
+	char* failed;
+	// ran out of fuel partway, what they printed is dropped and they run again from the start
+	// next slice (iterations can't change anything outside themselves, so that is safe)
+	char* cut_off;
+} Pfor;
+
+void start_pfor_worker(Pfor* pfor, Run* worker){
+	worker->parser = pfor->run->parser;
+	worker->memory = pfor->run->memory;
+	worker->function_blocks = pfor->run->function_blocks;
+	worker->pure = pfor->run->pure;
+	worker->job_capacity = 8;
+	worker->jobs = mem_alloc(worker->job_capacity*sizeof(Shell_Job));
+	worker->writers = new_writer_table();
+	worker->worker = 1;
+	worker->stack = new_frame_stack(max_frames);
+
+	Frame* frame = push_frame(&worker->stack);
+	frame->exprs = pfor->body;
+	frame->size = pfor->body_size;
+	frame->blocks = pfor->body_blocks;
+	for(size_t i = 0; i < pfor->var_count; i++){
+		Var view = pfor->vars[i];
+		view.name = mem_alloc(sizeof(char)*(view.name_size+1));
+		memcpy(view.name, pfor->vars[i].name, view.name_size+1);
+		view.borrowed = 1;
+		view.mapped = 0;
+		add_var(&frame->vars, &frame->var_count, &frame->var_cap, view);
+	}
+	// after the views so it is found before a var outside with the same name
+	Var counter = {0};
+	counter.name_size = pfor->counter->size;
+	counter.name = mem_alloc(sizeof(char)*(counter.name_size+1));
+	memcpy(counter.name, pfor->counter->str, counter.name_size);
+	counter.name[counter.name_size] = '\0';
+	set_var_int(&counter, pfor->start);
+	add_var(&frame->vars, &frame->var_count, &frame->var_cap, counter);
+}
+
+void free_pfor_worker(Run* worker){
+	free_frame_stack(&worker->stack);
+	for(size_t i = 0; worker->memo != NULL && i < MEMO_SLOTS; i++){
+		mem_free(worker->memo[i].key);
+		mem_free(worker->memo[i].value.str);
+	}
+	mem_free(worker->memo);
+	mem_free(worker->jobs);
+	close_writers(&worker->writers);
+}
+
+// runs one iteration with the worker, setting it up the first time
+void run_pfor_iteration(Pfor* pfor, Run* run, size_t index){
+	if(pfor->fuel > 0 && pfor->fuel_used >= pfor->fuel){
+		pfor->cut_off[index] = 1;
+		return;
+	}
+	if(run->stack.frames == NULL){
+		start_pfor_worker(pfor, run);
+	}
+	Frame* frame = &run->stack.frames[0];
+	Var* counter = &frame->vars[pfor->var_count];
+	if(counter->rope != NULL){
+		free_rope(counter->rope);
+		counter->rope = NULL;
+	}
+	set_var_int(counter, pfor->start+(int)(pfor->first+index));
+	frame->pc = 0;
+
+	run->out = open_memstream(&pfor->outputs[index], &pfor->output_sizes[index]);
+	run->exit_code = 0;
+	size_t statements = run->statements;
+	enum Run_Status status = eval_loop(run, pfor->fuel > 0 ? pfor->fuel-pfor->fuel_used : 0);
+	// only counted under a fuel limit, which is the one time iterations share a thread
+	if(pfor->fuel > 0){
+		pfor->fuel_used += run->statements-statements;
+	}
+	if(status == RUN_FAILED){
+		pfor->failed[index] = 1;
+	}
+	else if(status == RUN_YIELDED){
+		pfor->cut_off[index] = 1;
+	}
+
+	// what the iteration made goes, the views and the counter stay for the next one
+	while(run->stack.depth > 1){
+		pop_frame(&run->stack);
+	}
+	drop_params(&run->stack);
+	frame = &run->stack.frames[0];
+	for(size_t i = pfor->var_count+1; i < frame->var_count; i++){
+		free_var(&frame->vars[i]);
+	}
+	frame->var_count = pfor->var_count+1;
+	frame->scope_count = 0;
+}
+
+void pfor_iteration(void* context, size_t index, size_t worker_index){
+	Pfor* pfor = context;
+	Run* run = &pfor->workers[worker_index];
+	// a worker that had an allocation refused is left as it was, and so are its iterations
+	if(run->done){
+		pfor->failed[index] = 1;
+		return;
+	}
+	// the pool's threads are shared by every run, so they take on this one's memory each time
+	use_memory(pfor->run->memory);
+	// worker 0 is the main thread, whose own jump goes back in after
+	jmp_buf refused;
+	jmp_buf* outer = refuse_over_limit(&refused);
+	if(setjmp(refused) == 0){
+		run_pfor_iteration(pfor, run, index);
+	}
+	else{
+		// the worker's frames are halfway through something, free_memory takes back what they had
+		pfor->failed[index] = 1;
+		run->done = 1;
+	}
+	refuse_over_limit(outer);
+	// open_memstream made the output with plain malloc, it is written out by run_pfor
+	if(run->out != NULL){
+		fclose(run->out);
+		run->out = NULL;
+	}
+}
+
+// runs iterations first up to first+count on the pool
+void run_pfor_chunk(Pfor* pfor, size_t first, size_t count){
+	pfor->first = first;
+	memset(pfor->outputs, 0, count*sizeof(char*));
+	memset(pfor->output_sizes, 0, count*sizeof(size_t));
+	memset(pfor->failed, 0, count*sizeof(char));
+	memset(pfor->cut_off, 0, count*sizeof(char));
+	if(pfor->fuel > 0){
+		// with a fuel limit they run in order on this thread, so the fuel goes to the first
+		// iterations and only the last one to start can be cut off
+		for(size_t i = 0; i < count; i++){
+			pfor_iteration(pfor, i, 0);
+		}
+		return;
+	}
+	pool_run(count, pfor_iteration, pfor);
+}
+
+// a fuel of 0 means no limit, used gets how much the iterations took and finished how many
+// of them were done when it hands back PFOR_YIELDED
+int run_pfor(Run* run, Var* vars, size_t var_count, Expr* exprs, size_t pfor_index, size_t end_index, int start, int limit, size_t fuel, size_t* used, size_t* finished){
+	Token* counter = NODE(ast, call_of(ast, exprs[pfor_index]).argv[0])->as.literal;
+	Expr* body = exprs+pfor_index+1;
+	size_t body_size = end_index-pfor_index-1;
+	if(!check_pfor_body(vars, var_count, body, body_size, counter)){
+		return PFOR_REJECTED;
+	}
+	// everything the threads would otherwise fill in lazily gets done now so they only read it
+	for(size_t i = 0; i < ast->function_count; i++){
+		Function* function = &ast->functions[i];
+		parse_function(ast, function);
+		if(run->function_blocks[i] == NULL){
+			run->function_blocks[i] = prepare_statements(function->name, &function->exprs, &function->size, &function->capacity);
+		}
+		function_is_pure(*ast, run->pure, i);
+	}
+	for(size_t i = 0; i < var_count; i++){
+		find_var(&vars, var_count, vars[i].name, vars[i].name_size);
+	}
+
+	size_t count = limit-start;
+	size_t chunk = count < PFOR_CHUNK ? count : PFOR_CHUNK;
+	size_t workers = pool_workers();
+	Pfor pfor = {
+		.run = run,
+		.vars = vars,
+		.var_count = var_count,
+		.counter = counter,
+		.body = body,
+		.body_size = body_size,
+		.body_blocks = match_blocks(body, body_size),
+		.start = start,
+		.workers = mem_calloc(workers, sizeof(Run)),
+		.outputs = mem_calloc(chunk, sizeof(char*)),
+		.output_sizes = mem_calloc(chunk, sizeof(size_t)),
+		.failed = mem_calloc(chunk, sizeof(char)),
+		.cut_off = mem_calloc(chunk, sizeof(char)),
+		.fuel = fuel,
+	};
+
+	// only the main thread compiles jit code or writes the trace
+	int jit = jit_enabled;
+	jit_enabled = 0;
+	trace_hold(1);
+	run->memory->shared = 1;
+	int res = PFOR_RAN;
+	// like for, nothing after a chunk with a failed iteration runs
+	for(size_t first = 0; first < count && res == PFOR_RAN && !run->memory->refused; first += chunk){
+		size_t size = count-first < chunk ? count-first : chunk;
+		run_pfor_chunk(&pfor, first, size);
+		for(size_t i = 0; i < size; i++){
+			if(pfor.cut_off[i] && res == PFOR_RAN){
+				res = PFOR_YIELDED;
+				*finished = first+i;
+			}
+			if(pfor.outputs[i] != NULL && res != PFOR_YIELDED){
+				fwrite(pfor.outputs[i], sizeof(char), pfor.output_sizes[i], run->out);
+			}
+			free(pfor.outputs[i]);
+			if(pfor.failed[i] && res == PFOR_RAN){
+				res = PFOR_FAILED;
+			}
+		}
+	}
+	*used = pfor.fuel_used;
+	run->memory->shared = 0;
+	trace_hold(0);
+	jit_enabled = jit;
+
+	for(size_t i = 0; i < workers; i++){
+		if(pfor.workers[i].stack.frames != NULL && !pfor.workers[i].done){
+			free_pfor_worker(&pfor.workers[i]);
+		}
+	}
+	mem_free(pfor.workers);
+	mem_free(pfor.outputs);
+	mem_free(pfor.output_sizes);
+	mem_free(pfor.failed);
+	mem_free(pfor.cut_off);
+	mem_free(pfor.body_blocks);
+	return res;
+}
+
+enum Run_Status step_run(Run* run, size_t fuel){
+	if(run->done){
+		return run->exit_code == 0 ? RUN_DONE : RUN_FAILED;
+	}
+	ast = &run->parser;
+	jit_cache = &run->jit;
+	use_memory(run->memory);
+	unset_vars_are_zero = run->per_line;
+	// an allocation past the limit (or one that can't be made at all) lands back here, nothing
+	// after it in the statement runs, the run just stops
+	enum Run_Status status = RUN_FAILED;
+	jmp_buf refused;
+	jmp_buf* outer = refuse_over_limit(&refused);
+	if(setjmp(refused) == 0){
+		status = eval_loop(run, fuel);
+		refuse_over_limit(outer);
+	}
+	else{
+		refuse_over_limit(outer);
+		report_refused(run);
+		run->exit_code = 1;
+	}
+	if(status != RUN_YIELDED){
+		finish_run(run);
+	}
+	return status;
+}
+
+void free_run(Run* run){
+	use_memory(run->memory);
+	if(!run->done){
+		finish_run(run);
+	}
+	// a refused allocation left the frames and whatever else it was in the middle of half made,
+	// only what lives outside the run's memory gets cleaned up and free_memory takes the rest
+	if(run->memory->refused){
+		goto refused;
+	}
+	mem_free(run->jobs);
+	if(run->stack.frames != NULL){
+		free_frame_stack(&run->stack);
+	}
+	for(size_t i = 0; run->function_blocks != NULL && i < run->parser.function_count; i++){
+		mem_free(run->function_blocks[i]);
+	}
+	mem_free(run->function_blocks);
+	mem_free(run->program_blocks);
+	mem_free(run->pure);
+	for(size_t i = 0; run->memo != NULL && i < MEMO_SLOTS; i++){
+		mem_free(run->memo[i].key);
+		mem_free(run->memo[i].value.str);
+	}
+	mem_free(run->memo);
+	// after the frames, the restored vars may still have been pointing into it
+	unmap_file(run->snapshot, run->snapshot_size);
+	if(run->per_line){
+		free_record_reader(&run->records);
+	}
+	if(run->parser.exprs != NULL){
+		free_parser(&run->parser);
+	}
+	free_lexer(&run->lexer);
+refused:
+	if(ast == &run->parser){
+		ast = NULL;
+	}
+	jit_free_all(&run->jit);
+	if(jit_cache == &run->jit){
+		jit_cache = NULL;
+	}
+	free_memory(run->memory);
+	run->memory = NULL;
+}
+
+int run_code(char* src, size_t size, int debug_mode, int jit, size_t frame_limit, int per_line, size_t fuel, Allocator* allocator, size_t memory_limit){
+	max_frames = frame_limit > 0 ? frame_limit : DEFAULT_MAX_FRAMES;
+	jit_enabled = jit && jit_supported();
+	jit_verify = jit_enabled && debug_mode == 0;
+	if(jit && !jit_supported()){
+		printf("[INFO] The jit only runs on x86-64 linux, interpreting instead\n");
+	}
+	Run run;
+	int exit_code = start_run(&run, src, size, debug_mode, per_line, allocator, memory_limit);
+	if(exit_code == 0 && step_run(&run, fuel) == RUN_YIELDED){
+		RUN_ERROR("[ERR] Ran out of fuel after %zu statements\n", run.statements);
+		exit_code = 1;
+	}
+	else if(exit_code == 0){
+		exit_code = run.exit_code;
+	}
+	if(debug_mode == 0){
+		Memory* memory = run.memory;
+		printf("[DEBG] Memory: %zu bytes at most, %zu bytes over %zu allocations\n", memory->peak, memory->total, memory->allocations);
 	}
-	free_lexer(&lexer);
+	free_run(&run);
 	return exit_code;
 }
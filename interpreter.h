@@ -2,7 +2,22 @@
 #define INTERPRETER_H
 #include <stddef.h>
 #include "lexer.h"
+#include "rope.h"
+#include "parser.h"
+#include "shell.h"
+#include "records.h"
+#include "files.h"
+#include "memory.h"
+#include "map.h"
+#include "jit.h"
 
+#define DEFAULT_MAX_FRAMES 10000
+#define MEMO_SLOTS 4096
+
+// a var owns its name and its str (or rope), unless borrowed or mapped says otherwise
+// values coming out of solve_value belong to the caller until handed to assign_var
+// (or stack.returned) which takes them over, anything else has to be freed where it was made
+// temporary results while solving an expression stay on the C stack
 typedef struct {
 	char* name;
 	size_t name_size;
@@ -10,8 +25,117 @@ typedef struct {
 	enum TokenType type;
 	char* str;
 	size_t str_size;
+	// strings built with + stay a rope until read, str is NULL while this is set
+	Rope* rope;
+	// str points into something else (a -n record or a loaded file), so it is never freed or resized
+	int borrowed;
+	// str is a file mapped by load, it gets unmapped instead of freed
+	int mapped;
+	// set (with type MAP and str NULL) when the var is a map, borrowed says the map is someone else's
+	Map* map;
 } Var;
 
-int run_code(char* src, size_t size, int debug_mode);
+// one running function (or the top level), calls push these instead of recursing in C
+typedef struct {
+	Expr* exprs;
+	size_t size;
+	size_t pc;
+	size_t* blocks;
+	Var* vars;
+	size_t var_count;
+	size_t var_cap;
+	// var_count when each open for/each block was entered, vars past it go away at its end
+	size_t* scopes;
+	size_t scope_count;
+	size_t scope_capacity;
+	// the caller's var that gets the return value, NULL if nothing wants it
+	Token* return_name;
+	// set when the function is pure, the return value gets cached under it
+	char* memo_key;
+	size_t memo_key_size;
+	size_t memo_hash;
+	int memo_function;
+} Frame;
+
+typedef struct {
+	Frame* frames;
+	size_t depth;
+	size_t capacity;
+	size_t max_depth;
+	// argument values waiting to be bound in the callee's frame
+	Var* params;
+	size_t param_count;
+	size_t param_capacity;
+	Var returned;
+	int has_returned;
+} Frame_Stack;
+
+// results of pure functions keyed on their arguments, a slot is replaced on collision
+// a run's table is only made once a pure call first returns, most never have one
+typedef struct {
+	char* key;
+	size_t key_size;
+	int function;
+	Var value;
+} Memo_Entry;
+
+enum Run_Status {
+	RUN_DONE,
+	// the fuel ran out between two statements, step_run again to carry on
+	RUN_YIELDED,
+	RUN_FAILED,
+};
+
+// one program from start to finish, it can be run a slice at a time so a host can take turns
+// between lots of them on one thread, nothing in here depends on where the Run lives
+typedef struct {
+	Lexer lexer;
+	Parser parser;
+	Frame_Stack stack;
+	size_t* program_blocks;
+	size_t** function_blocks;
+	int* pure;
+	Memo_Entry* memo;
+	Shell_Job* jobs;
+	size_t job_count;
+	size_t job_capacity;
+	Writer_Table writers;
+	int per_line;
+	Record_Reader records;
+	// where print goes, each pfor iteration gets its own so they come out in order
+	FILE* out;
+	// runs pfor iterations on a pool thread, its top frame is kept for the next iteration
+	int worker;
+	size_t bound_fields;
+	// of the source and every function it ended up with, snapshots are only restored when it matches
+	size_t source_hash;
+	// the file the top level vars were restored from, their strings point into it
+	char* snapshot;
+	size_t snapshot_size;
+	// everything the run allocates comes from here, and what it used is counted in it
+	Memory* memory;
+	// what --jit compiled for this run's nodes, freed with it
+	Jit_Cache jit;
+	// statements run over every slice so far
+	size_t statements;
+	int done;
+	int exit_code;
+} Run;
+
+// appends onto a frame's vars, growing them when they are full
+void add_var(Var** vars, size_t* size, size_t* capacity, Var var);
+
+// lexes and parses src and gets it ready to step, non zero if it had errors (free_run it either way)
+// allocator of NULL uses the pooled default, a memory_limit (in bytes) of 0 means no limit
+int start_run(Run* run, char* src, size_t size, int debug_mode, int per_line, Allocator* allocator, size_t memory_limit);
+// runs at most fuel statements (0 for no limit), a jit compiled loop counts as one
+enum Run_Status step_run(Run* run, size_t fuel);
+// also how a run gets aborted, its shell jobs are waited on and its files flushed
+void free_run(Run* run);
+
+// frame_limit of 0 uses DEFAULT_MAX_FRAMES, per_line runs the program once for each line of stdin
+// fuel of 0 lets it run as long as it wants, otherwise it is stopped after that many statements
+// the run stops with an error once it has more than memory_limit bytes (0 for no limit)
+int run_code(char* src, size_t size, int debug_mode, int jit, size_t frame_limit, int per_line, size_t fuel, Allocator* allocator, size_t memory_limit);
 
 #endif // INTERPRETER_H
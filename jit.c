@@ -0,0 +1,379 @@
+#define _DEFAULT_SOURCE
+#include "jit.h"
+#include "lexer.h"
+#include "parser.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#if JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+typedef struct {
+	unsigned char* bytes;
+	size_t size;
+	size_t capacity;
+	// spots holding a rel32 to the deopt stub, patched once it is placed
+	size_t* deopt_fixups;
+	size_t deopt_count;
+	size_t deopt_capacity;
+} Jit_Buffer;
+
+int jit_supported(void){
+	return JIT_SUPPORTED;
+}
+
+void emit_byte(Jit_Buffer* buffer, unsigned char byte){
+	if(buffer->size >= buffer->capacity){
+		buffer->capacity *= 2;
+		buffer->bytes = mem_realloc(buffer->bytes, buffer->capacity);
+	}
+	buffer->bytes[buffer->size] = byte;
+	buffer->size++;
+}
+
+void emit_bytes(Jit_Buffer* buffer, const unsigned char* bytes, size_t count){
+	for(size_t i = 0; i < count; i++){
+		emit_byte(buffer, bytes[i]);
+	}
+}
+
+void emit_u32(Jit_Buffer* buffer, uint32_t value){
+	for(int i = 0; i < 4; i++){
+		emit_byte(buffer, (value >> (8*i)) & 0xff);
+	}
+}
+
+void patch_u32(Jit_Buffer* buffer, size_t at, uint32_t value){
+	for(int i = 0; i < 4; i++){
+		buffer->bytes[at+i] = (value >> (8*i)) & 0xff;
+	}
+}
+
+// jcc/jmp to the deopt stub, the rel32 is filled in by finish_code
+void emit_deopt_jump(Jit_Buffer* buffer, const unsigned char* opcode, size_t opcode_size){
+	emit_bytes(buffer, opcode, opcode_size);
+	if(buffer->deopt_count >= buffer->deopt_capacity){
+		buffer->deopt_capacity *= 2;
+		buffer->deopt_fixups = mem_realloc(buffer->deopt_fixups, buffer->deopt_capacity*sizeof(size_t));
+	}
+	buffer->deopt_fixups[buffer->deopt_count] = buffer->size;
+	buffer->deopt_count++;
+	emit_u32(buffer, 0);
+}
+
+int find_slot(Jit_Code* code, Token* name){
+	for(size_t i = 0; i < code->slot_count; i++){
+		if(code->slot_names[i]->size == name->size && strncmp(code->slot_names[i]->str, name->str, name->size) == 0){
+			return (int)i;
+		}
+	}
+	if(code->slot_count >= JIT_MAX_SLOTS-1){ // last one is kept for results
+		return -1;
+	}
+	code->slot_names[code->slot_count] = name;
+	code->slot_count++;
+	return (int)code->slot_count-1;
+}
+
+// leaves the value of expr in eax
+int emit_expr(Parser* parser, Jit_Buffer* buffer, Jit_Code* code, Expr expr){
+	Node* node = NODE(parser, expr);
+	while(node->type == GROUPED){
+		node = NODE(parser, node->as.grouped);
+	}
+	if(node->type == LITERAL){
+		Token* literal = node->as.literal;
+		if(literal->type == INTEGER){
+			emit_byte(buffer, 0xb8); // mov eax, imm32
+			emit_u32(buffer, (uint32_t)atoi(literal->str));
+			return 0;
+		}
+		if(literal->type == IDENTIFIER){
+			int slot = find_slot(code, literal);
+			if(slot < 0){
+				return 1;
+			}
+			emit_bytes(buffer, (unsigned char[]){0x8b, 0x87}, 2); // mov eax, [rdi+disp32]
+			emit_u32(buffer, (uint32_t)(slot*sizeof(int)));
+			return 0;
+		}
+		return 1;
+	}
+	if(node->type == TEMP){
+		// read like a var, a temp that couldn't be set fails the slot check and the interpreter takes over
+		int slot = find_slot(code, parser->temps[node->as.temp.temp]);
+		if(slot < 0){
+			return 1;
+		}
+		emit_bytes(buffer, (unsigned char[]){0x8b, 0x87}, 2); // mov eax, [rdi+disp32]
+		emit_u32(buffer, (uint32_t)(slot*sizeof(int)));
+		return 0;
+	}
+	if(node->type != OPERATION){
+		return 1;
+	}
+
+	if(emit_expr(parser, buffer, code, node->as.operation.rhs) != 0){
+		return 1;
+	}
+	emit_byte(buffer, 0x50); // push rax
+	if(emit_expr(parser, buffer, code, node->as.operation.lhs) != 0){
+		return 1;
+	}
+	emit_byte(buffer, 0x59); // pop rcx
+
+	switch(node->as.operation.operator){
+		case PLUS: emit_bytes(buffer, (unsigned char[]){0x01, 0xc8}, 2); break; // add eax, ecx
+		case MINUS: emit_bytes(buffer, (unsigned char[]){0x29, 0xc8}, 2); break; // sub eax, ecx
+		case STAR: emit_bytes(buffer, (unsigned char[]){0x0f, 0xaf, 0xc1}, 3); break; // imul eax, ecx
+		case SLASH:
+		{
+			emit_bytes(buffer, (unsigned char[]){0x85, 0xc9}, 2); // test ecx, ecx
+			emit_deopt_jump(buffer, (unsigned char[]){0x0f, 0x84}, 2); // jz deopt
+			emit_bytes(buffer, (unsigned char[]){0x99, 0xf7, 0xf9}, 3); // cdq; idiv ecx
+			break;
+		}
+		case EQEQ: case LT: case LTEQ: case GT: case GTEQ:
+		{
+			unsigned char setcc = 0;
+			switch(node->as.operation.operator){
+				case EQEQ: setcc = 0x94; break;
+				case LT: setcc = 0x9c; break;
+				case LTEQ: setcc = 0x9e; break;
+				case GT: setcc = 0x9f; break;
+				default: setcc = 0x9d; break;
+			}
+			emit_bytes(buffer, (unsigned char[]){0x39, 0xc8, 0x0f, setcc, 0xc0}, 5); // cmp eax, ecx; setcc al
+			emit_bytes(buffer, (unsigned char[]){0x0f, 0xb6, 0xc0}, 3); // movzx eax, al
+			break;
+		}
+		default: return 1;
+	}
+	return 0;
+}
+
+// r8d holds the status to return if the code has to deopt
+void emit_deopt_status(Jit_Buffer* buffer, uint32_t status){
+	emit_bytes(buffer, (unsigned char[]){0x41, 0xb8}, 2); // mov r8d, imm32
+	emit_u32(buffer, status);
+}
+
+Jit_Buffer new_buffer(void){
+	Jit_Buffer buffer = {
+		.size = 0,
+		.capacity = 64,
+		.bytes = mem_alloc(64),
+		.deopt_count = 0,
+		.deopt_capacity = 8,
+		.deopt_fixups = mem_alloc(8*sizeof(size_t)),
+	};
+	return buffer;
+}
+
+void free_buffer(Jit_Buffer* buffer){
+	mem_free(buffer->bytes);
+	mem_free(buffer->deopt_fixups);
+}
+
+// places the deopt stub and copies everything into executable pages
+Jit_Code* finish_code(Jit_Buffer* buffer, Jit_Code* code){
+	size_t stub = buffer->size;
+	emit_bytes(buffer, (unsigned char[]){0x44, 0x89, 0xc0, 0xc3}, 4); // mov eax, r8d; ret
+	for(size_t i = 0; i < buffer->deopt_count; i++){
+		size_t at = buffer->deopt_fixups[i];
+		patch_u32(buffer, at, (uint32_t)(stub - (at+4)));
+	}
+
+#if JIT_SUPPORTED
+	// whole pages are what the run really holds, so that's what it gets charged
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t size = (buffer->size+page-1)/page*page;
+	void* pages = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(pages == MAP_FAILED){
+		fprintf(stderr, "[ERR] Failed to map pages for jit code\n");
+		mem_free(code);
+		return NULL;
+	}
+	mem_charge_mapping(pages, size);
+	memcpy(pages, buffer->bytes, buffer->size);
+	if(mprotect(pages, size, PROT_READ | PROT_EXEC) != 0){
+		fprintf(stderr, "[ERR] Failed to make jit code executable\n");
+		mem_untrack_mapping(pages);
+		munmap(pages, size);
+		mem_free(code);
+		return NULL;
+	}
+	code->code = pages;
+	code->code_size = size;
+	code->entry = (int (*)(int*))pages;
+	return code;
+#else
+	mem_free(code);
+	return NULL;
+#endif
+}
+
+Jit_Code* jit_compile_expr(Parser* parser, Expr expr){
+	if(!JIT_SUPPORTED){
+		return NULL;
+	}
+	Jit_Code* code = mem_calloc(1, sizeof(Jit_Code));
+	code->result_slot = JIT_MAX_SLOTS-1;
+	Jit_Buffer buffer = new_buffer();
+
+	emit_deopt_status(&buffer, 1);
+	if(emit_expr(parser, &buffer, code, expr) != 0){
+		free_buffer(&buffer);
+		mem_free(code);
+		return NULL;
+	}
+	emit_bytes(&buffer, (unsigned char[]){0x89, 0x87}, 2); // mov [rdi+disp32], eax
+	emit_u32(&buffer, (uint32_t)(code->result_slot*sizeof(int)));
+	emit_bytes(&buffer, (unsigned char[]){0x31, 0xc0, 0xc3}, 3); // xor eax, eax; ret
+
+	code = finish_code(&buffer, code);
+	free_buffer(&buffer);
+	return code;
+}
+
+Jit_Code* jit_compile_loop(Parser* parser, Expr* exprs, size_t for_index, size_t end_index){
+	if(!JIT_SUPPORTED){
+		return NULL;
+	}
+	struct Expr_Function_Call loop = call_of(parser, exprs[for_index]);
+	if(loop.argc != 2 || NODE(parser, loop.argv[0])->type != LITERAL || NODE(parser, loop.argv[0])->as.literal->type != IDENTIFIER){
+		return NULL;
+	}
+
+	Jit_Code* code = mem_calloc(1, sizeof(Jit_Code));
+	code->result_slot = JIT_MAX_SLOTS-1;
+	Jit_Buffer buffer = new_buffer();
+	int counter = find_slot(code, NODE(parser, loop.argv[0])->as.literal);
+
+	// top: if counter >= limit, leave
+	size_t top = buffer.size;
+	emit_deopt_status(&buffer, (uint32_t)JIT_LOOP_LIMIT);
+	if(emit_expr(parser, &buffer, code, loop.argv[1]) != 0){
+		goto cannot_compile;
+	}
+	emit_bytes(&buffer, (unsigned char[]){0x89, 0xc1}, 2); // mov ecx, eax
+	emit_bytes(&buffer, (unsigned char[]){0x8b, 0x87}, 2); // mov eax, [rdi+counter]
+	emit_u32(&buffer, (uint32_t)(counter*sizeof(int)));
+	emit_bytes(&buffer, (unsigned char[]){0x39, 0xc8, 0x0f, 0x8d}, 4); // cmp eax, ecx; jge done
+	size_t done_fixup = buffer.size;
+	emit_u32(&buffer, 0);
+
+	for(size_t i = for_index+1; i < end_index; i++){
+		Node* node = NODE(parser, exprs[i]);
+		if(node->type == TEMP){
+			emit_deopt_status(&buffer, (uint32_t)(i-for_index));
+			if(emit_expr(parser, &buffer, code, node->as.temp.expr) != 0){
+				goto cannot_compile;
+			}
+			size_t known = code->slot_count;
+			int slot = find_slot(code, parser->temps[node->as.temp.temp]);
+			if(slot < 0){
+				goto cannot_compile;
+			}
+			code->scratch[slot] = (size_t)slot >= known;
+			emit_bytes(&buffer, (unsigned char[]){0x89, 0x87}, 2); // mov [rdi+slot], eax
+			emit_u32(&buffer, (uint32_t)(slot*sizeof(int)));
+			continue;
+		}
+		if(node->type != FUNCTION_CALL){
+			goto cannot_compile;
+		}
+		struct Expr_Function_Call set = call_of(parser, exprs[i]);
+		if(set.type != VAR || set.argc != 2 || NODE(parser, set.argv[0])->type != LITERAL
+		|| NODE(parser, set.argv[0])->as.literal->type != IDENTIFIER){
+			goto cannot_compile;
+		}
+		emit_deopt_status(&buffer, (uint32_t)(i-for_index));
+		if(emit_expr(parser, &buffer, code, set.argv[1]) != 0){
+			goto cannot_compile;
+		}
+		int slot = find_slot(code, NODE(parser, set.argv[0])->as.literal);
+		if(slot < 0){
+			goto cannot_compile;
+		}
+		emit_bytes(&buffer, (unsigned char[]){0x89, 0x87}, 2); // mov [rdi+slot], eax
+		emit_u32(&buffer, (uint32_t)(slot*sizeof(int)));
+	}
+
+	// counter++ and back to the top
+	emit_bytes(&buffer, (unsigned char[]){0x8b, 0x87}, 2);
+	emit_u32(&buffer, (uint32_t)(counter*sizeof(int)));
+	emit_bytes(&buffer, (unsigned char[]){0x83, 0xc0, 0x01}, 3); // add eax, 1
+	emit_bytes(&buffer, (unsigned char[]){0x89, 0x87}, 2);
+	emit_u32(&buffer, (uint32_t)(counter*sizeof(int)));
+	emit_byte(&buffer, 0xe9); // jmp top
+	emit_u32(&buffer, (uint32_t)(top - (buffer.size+4)));
+
+	patch_u32(&buffer, done_fixup, (uint32_t)(buffer.size - (done_fixup+4)));
+	emit_bytes(&buffer, (unsigned char[]){0x31, 0xc0, 0xc3}, 3); // xor eax, eax; ret
+
+	code = finish_code(&buffer, code);
+	free_buffer(&buffer);
+	return code;
+
+cannot_compile:
+	free_buffer(&buffer);
+	mem_free(code);
+	return NULL;
+}
+
+Jit_Entry* jit_entry(Jit_Cache* cache, void* key){
+	if(cache->count*2 >= cache->capacity){
+		// grow and rehash, the table is open addressed on the node pointer
+		// made before the cache changes at all, a refused allocation leaves it as it was
+		size_t old_capacity = cache->capacity;
+		Jit_Entry* old_entries = cache->entries;
+		size_t capacity = old_capacity == 0 ? 64 : old_capacity*2;
+		cache->entries = mem_calloc(capacity, sizeof(Jit_Entry));
+		cache->capacity = capacity;
+		for(size_t i = 0; i < old_capacity; i++){
+			if(old_entries[i].key == NULL){
+				continue;
+			}
+			size_t j = ((uintptr_t)old_entries[i].key >> 4) & (cache->capacity-1);
+			while(cache->entries[j].key != NULL){
+				j = (j+1) & (cache->capacity-1);
+			}
+			cache->entries[j] = old_entries[i];
+		}
+		mem_free(old_entries);
+	}
+
+	size_t i = ((uintptr_t)key >> 4) & (cache->capacity-1);
+	while(cache->entries[i].key != NULL && cache->entries[i].key != key){
+		i = (i+1) & (cache->capacity-1);
+	}
+	if(cache->entries[i].key == NULL){
+		cache->entries[i].key = key;
+		cache->count++;
+	}
+	return &cache->entries[i];
+}
+
+void jit_free_all(Jit_Cache* cache){
+	for(size_t i = 0; i < cache->capacity; i++){
+		Jit_Code* code = cache->entries[i].code;
+		if(code == NULL){
+			continue;
+		}
+#if JIT_SUPPORTED
+		mem_untrack_mapping(code->code);
+		munmap(code->code, code->code_size);
+#endif
+		mem_free(code);
+	}
+	mem_free(cache->entries);
+	cache->entries = NULL;
+	cache->count = 0;
+	cache->capacity = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef JIT_H
+#define JIT_H
+#include <stddef.h>
+#include "lexer.h"
+#include "parser.h"
+
+#if defined(__linux__) && defined(__x86_64__)
+#define JIT_SUPPORTED 1
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+#define JIT_MAX_SLOTS 64
+// how many times something has to run before it gets compiled
+#define JIT_HOT_COUNT 8
+
+// native code works on ints in a slot array, the interpreter loads each var
+// into its slot (checking it is an INTEGER first) and stores them back after
+typedef struct {
+	unsigned char* code;
+	size_t code_size;
+	int (*entry)(int* slots);
+	Token* slot_names[JIT_MAX_SLOTS];
+	// temps the code sets before reading, they aren't loaded so they needn't exist yet
+	char scratch[JIT_MAX_SLOTS];
+	size_t slot_count;
+	size_t result_slot;
+} Jit_Code;
+
+typedef struct {
+	void* key;
+	unsigned int hits;
+	int failed;
+	Jit_Code* code;
+} Jit_Entry;
+
+// hit counts and compiled code keyed on the node, each run has its own so a node address
+// a later parser hands out again never finds another program's code
+typedef struct {
+	Jit_Entry* entries;
+	size_t count;
+	size_t capacity;
+} Jit_Cache;
+
+int jit_supported(void);
+// returns NULL when the expression has anything that isn't integer math
+Jit_Code* jit_compile_expr(Parser* parser, Expr expr);
+// what a compiled loop gives when working out its limit needs the interpreter (division by zero)
+#define JIT_LOOP_LIMIT -1
+
+// compiles a `for` loop whose body is only integer var (and temp) sets, the returned code
+// gives 0 when the loop finished, JIT_LOOP_LIMIT, or 1+n when statement n of the body needs
+// the interpreter (division by zero)
+Jit_Code* jit_compile_loop(Parser* parser, Expr* exprs, size_t for_index, size_t end_index);
+Jit_Entry* jit_entry(Jit_Cache* cache, void* key);
+void jit_free_all(Jit_Cache* cache);
+
+#endif // JIT_H
@@ -1,49 +1,269 @@
 #include "lexer.h"
+#include "memory.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <stddef.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+// the AVX2 scanner is built whatever -m flags are used and only picked when the CPU has it
+#if defined(__GNUC__) && defined(__x86_64__)
+#define AVX2_SCANNER
+#include <immintrin.h>
+#endif
+
 void incr_size(Lexer* ptr){
 	ptr->size++;
 	if(ptr->size >= ptr->capacity){
 		ptr->capacity *= 2;
-		ptr->tokens = realloc(ptr->tokens, ptr->capacity*sizeof(Token));
+		ptr->tokens = mem_realloc(ptr->tokens, ptr->capacity*sizeof(Token));
 	}
 }
 
+#define IS_RESERVED(word) (size == (int)strlen(word) && strncmp(src+offset, word, size) == 0)
+
 enum TokenType check_for_reserved(char* src, int offset, int size){
-	char str[size];
-	strncpy(str, src+offset, size);
-
-	if(strncmp(str, "var", strlen("var")) == 0){ return VAR; }
-	if(strncmp(str, "print", strlen("print")) == 0){ return PRINT; }
-	if(strncmp(str, "read", strlen("read")) == 0){ return READ; }
-	if(strncmp(str, "for", strlen("for")) == 0){ return FOR; }
-	if(strncmp(str, "while", strlen("while")) == 0){ return WHILE; }
-	if(strncmp(str, "if", strlen("if")) == 0){ return IF; }
-	if(strncmp(str, "else", strlen("else")) == 0){ return ELSE; }
-	if(strncmp(str, "elif", strlen("elif")) == 0){ return ELIF; }
-	if(strncmp(str, "and", strlen("and")) == 0){ return AND; }
-	if(strncmp(str, "or", strlen("or")) == 0){ return OR; }
-	if(strncmp(str, "not", strlen("not")) == 0){ return NOT; }
-	if(strncmp(str, "exit", strlen("exit")) == 0){ return EXIT; }
-	if(strncmp(str, "end", strlen("end")) == 0){ return END; }
-	if(strncmp(str, "func", strlen("func")) == 0){ return FUNC; }
-	if(strncmp(str, "call", strlen("call")) == 0){ return CALL; }
+	if(IS_RESERVED("var")){ return VAR; }
+	if(IS_RESERVED("print")){ return PRINT; }
+	if(IS_RESERVED("read")){ return READ; }
+	if(IS_RESERVED("for")){ return FOR; }
+	if(IS_RESERVED("while")){ return WHILE; }
+	if(IS_RESERVED("if")){ return IF; }
+	if(IS_RESERVED("else")){ return ELSE; }
+	if(IS_RESERVED("elif")){ return ELIF; }
+	if(IS_RESERVED("and")){ return AND; }
+	if(IS_RESERVED("or")){ return OR; }
+	if(IS_RESERVED("not")){ return NOT; }
+	if(IS_RESERVED("exit")){ return EXIT; }
+	if(IS_RESERVED("end")){ return END; }
+	if(IS_RESERVED("func")){ return FUNC; }
+	if(IS_RESERVED("call")){ return CALL; }
+	if(IS_RESERVED("return")){ return RETURN; }
+	if(IS_RESERVED("sh")){ return SH; }
+	if(IS_RESERVED("spawn")){ return SPAWN; }
+	if(IS_RESERVED("wait")){ return WAIT; }
+	if(IS_RESERVED("load")){ return LOAD; }
+	if(IS_RESERVED("each")){ return EACH; }
+	if(IS_RESERVED("write")){ return WRITE; }
+	if(IS_RESERVED("pfor")){ return PFOR; }
+	if(IS_RESERVED("snapshot")){ return SNAPSHOT; }
+	if(IS_RESERVED("map")){ return MAP; }
+	if(IS_RESERVED("put")){ return PUT; }
+	if(IS_RESERVED("get")){ return GET; }
+	if(IS_RESERVED("has")){ return HAS; }
+	if(IS_RESERVED("delete")){ return DELETE; }
 
 	return IDENTIFIER;
 }
 
-void add_token(Lexer* ptr, char* src, enum TokenType type, int offset, int size){
+// the runs of bytes lex jumps over instead of going through the switch one at a time
+enum Run_Kind {
+	RUN_COMMENT, // up to the newline
+	RUN_STRING, // up to the closing quote or a newline, which lex counts and carries on past
+	RUN_SPACE, // spaces, tabs and \r
+	RUN_WORD, // what an identifier carries on with
+	RUN_DIGITS,
+};
+
+// the same as isalnum and isdigit in the C locale, which is the only one frosting runs in
+__attribute__((always_inline)) inline int keeps_run(char c, enum Run_Kind kind){
+	switch(kind){
+		case RUN_COMMENT: return c != '\n';
+		case RUN_STRING: return c != '"' && c != '\n';
+		case RUN_SPACE: return c == ' ' || c == '\t' || c == '\r';
+		case RUN_WORD: return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+		case RUN_DIGITS: return c >= '0' && c <= '9';
+	}
+	return 0;
+}
+
+// the first index from i on that doesn't keep the run going, size if they all do
+typedef size_t (*Run_End)(char* src, size_t i, size_t size, enum Run_Kind kind);
+
+size_t scalar_run_end(char* src, size_t i, size_t size, enum Run_Kind kind){
+	while(i < size && keeps_run(src[i], kind)){
+		i++;
+	}
+	return i;
+}
+
+#ifdef __SSE2__
+#define SPLAT4(c) c, c, c, c
+#define SPLAT(c) { SPLAT4(c), SPLAT4(c), SPLAT4(c), SPLAT4(c), SPLAT4(c), SPLAT4(c), SPLAT4(c), SPLAT4(c) }
+
+// what the scanners compare chunks against, loaded instead of made with set1 every call
+// which a build without -O does a byte at a time, 32 of each so AVX2 can load them too
+enum Run_Byte { BYTE_NEWLINE, BYTE_QUOTE, BYTE_SPACE, BYTE_TAB, BYTE_RETURN, BYTE_UNDERSCORE,
+	BYTE_CASE, BYTE_BEFORE_A, BYTE_AFTER_Z, BYTE_BEFORE_0, BYTE_AFTER_9 };
+const char run_bytes[][32] = {
+	SPLAT('\n'), SPLAT('"'), SPLAT(' '), SPLAT('\t'), SPLAT('\r'), SPLAT('_'),
+	SPLAT(0x20), SPLAT('a'-1), SPLAT('z'+1), SPLAT('0'-1), SPLAT('9'+1),
+};
+
+#define SSE2_BYTES(byte) _mm_loadu_si128((__m128i*)run_bytes[byte])
+
+// before and after are both under 128 so the signed compares are fine
+__attribute__((always_inline)) inline __m128i sse2_in_range(__m128i chunk, enum Run_Byte before, enum Run_Byte after){
+	return _mm_and_si128(_mm_cmpgt_epi8(chunk, SSE2_BYTES(before)), _mm_cmplt_epi8(chunk, SSE2_BYTES(after)));
+}
+
+// bit j is set when byte j of chunk keeps the run going
+__attribute__((always_inline)) inline unsigned int sse2_keeps_run(__m128i chunk, enum Run_Kind kind){
+	__m128i keeps = _mm_setzero_si128();
+	switch(kind){
+		// these two find the bytes that stop the run and flip them at the end
+		case RUN_STRING:
+			keeps = _mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_QUOTE));
+			// fall through
+		case RUN_COMMENT:
+			keeps = _mm_or_si128(keeps, _mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_NEWLINE)));
+			return ~_mm_movemask_epi8(keeps) & 0xffff;
+		case RUN_SPACE:
+			keeps = _mm_or_si128(_mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_SPACE)), _mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_TAB)));
+			keeps = _mm_or_si128(keeps, _mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_RETURN)));
+			break;
+		case RUN_WORD:
+			// or-ing in 0x20 lowercases A-Z and moves nothing else into a-z
+			keeps = sse2_in_range(_mm_or_si128(chunk, SSE2_BYTES(BYTE_CASE)), BYTE_BEFORE_A, BYTE_AFTER_Z);
+			keeps = _mm_or_si128(keeps, _mm_cmpeq_epi8(chunk, SSE2_BYTES(BYTE_UNDERSCORE)));
+			// fall through
+		case RUN_DIGITS:
+			keeps = _mm_or_si128(keeps, sse2_in_range(chunk, BYTE_BEFORE_0, BYTE_AFTER_9));
+			break;
+	}
+	return _mm_movemask_epi8(keeps);
+}
+
+size_t sse2_run_end(char* src, size_t i, size_t size, enum Run_Kind kind){
+	// most space runs and plenty of words end straight away, not worth a load
+	if(i < size && !keeps_run(src[i], kind)){
+		return i;
+	}
+	while(size-i >= 16){
+		unsigned int stops = ~sse2_keeps_run(_mm_loadu_si128((__m128i*)(src+i)), kind) & 0xffff;
+		if(stops != 0){
+			return i + __builtin_ctz(stops);
+		}
+		i += 16;
+	}
+	return scalar_run_end(src, i, size, kind);
+}
+#endif
+
+#ifdef AVX2_SCANNER
+#define AVX2_BYTES(byte) _mm256_loadu_si256((__m256i*)run_bytes[byte])
+
+__attribute__((target("avx2"), always_inline)) inline __m256i avx2_in_range(__m256i chunk, enum Run_Byte before, enum Run_Byte after){
+	return _mm256_and_si256(_mm256_cmpgt_epi8(chunk, AVX2_BYTES(before)), _mm256_cmpgt_epi8(AVX2_BYTES(after), chunk));
+}
+
+// sse2_keeps_run 32 bytes at a time
+__attribute__((target("avx2"), always_inline)) inline unsigned int avx2_keeps_run(__m256i chunk, enum Run_Kind kind){
+	__m256i keeps = _mm256_setzero_si256();
+	switch(kind){
+		// these two find the bytes that stop the run and flip them at the end
+		case RUN_STRING:
+			keeps = _mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_QUOTE));
+			// fall through
+		case RUN_COMMENT:
+			keeps = _mm256_or_si256(keeps, _mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_NEWLINE)));
+			return ~(unsigned int)_mm256_movemask_epi8(keeps);
+		case RUN_SPACE:
+			keeps = _mm256_or_si256(_mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_SPACE)), _mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_TAB)));
+			keeps = _mm256_or_si256(keeps, _mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_RETURN)));
+			break;
+		case RUN_WORD:
+			keeps = avx2_in_range(_mm256_or_si256(chunk, AVX2_BYTES(BYTE_CASE)), BYTE_BEFORE_A, BYTE_AFTER_Z);
+			keeps = _mm256_or_si256(keeps, _mm256_cmpeq_epi8(chunk, AVX2_BYTES(BYTE_UNDERSCORE)));
+			// fall through
+		case RUN_DIGITS:
+			keeps = _mm256_or_si256(keeps, avx2_in_range(chunk, BYTE_BEFORE_0, BYTE_AFTER_9));
+			break;
+	}
+	return (unsigned int)_mm256_movemask_epi8(keeps);
+}
+
+__attribute__((target("avx2")))
+size_t avx2_run_end(char* src, size_t i, size_t size, enum Run_Kind kind){
+	if(i < size && !keeps_run(src[i], kind)){
+		return i;
+	}
+	while(size-i >= 32){
+		unsigned int stops = ~avx2_keeps_run(_mm256_loadu_si256((__m256i*)(src+i)), kind);
+		if(stops != 0){
+			_mm256_zeroupper();
+			return i + __builtin_ctz(stops);
+		}
+		i += 32;
+	}
+	// code built without AVX runs slowly while the upper halves are dirty, and a build
+	// without -O doesn't clear them by itself
+	_mm256_zeroupper();
+	return sse2_run_end(src, i, size, kind);
+}
+#endif
+
+int lex_scanner_supported(enum Lex_Scanner scanner){
+	switch(scanner){
+		case LEX_BEST:
+		case LEX_SCALAR:
+			return 1;
+		case LEX_SSE2:
+#ifdef __SSE2__
+			return 1;
+#else
+			return 0;
+#endif
+		case LEX_AVX2:
+#ifdef AVX2_SCANNER
+			return __builtin_cpu_supports("avx2");
+#else
+			return 0;
+#endif
+	}
+	return 0;
+}
+
+// asked every lex instead of kept in a global, so threads lexing at once never race on it
+Run_End pick_run_end(enum Lex_Scanner scanner){
+	switch(scanner){
+		case LEX_SCALAR:
+			return scalar_run_end;
+#ifdef __SSE2__
+		case LEX_SSE2:
+			return sse2_run_end;
+#endif
+#ifdef AVX2_SCANNER
+		case LEX_AVX2:
+			return avx2_run_end;
+#endif
+		default:
+			break;
+	}
+#ifdef AVX2_SCANNER
+	if(__builtin_cpu_supports("avx2")){
+		return avx2_run_end;
+	}
+#endif
+#ifdef __SSE2__
+	return sse2_run_end;
+#else
+	return scalar_run_end;
+#endif
+}
+
+void add_token(Lexer* ptr, char* src, enum TokenType type, int offset, int size, int line){
 	if(type == IDENTIFIER){
 		type = check_for_reserved(src, offset, size);
 	}
 	ptr->tokens[ptr->size] = (Token){
 		.type = type,
 		.size = size,
-		.str = malloc(sizeof(char)*(size+1))
+		.line = line,
+		.str = mem_alloc(sizeof(char)*(size+1))
 	};
 	strncpy(ptr->tokens[ptr->size].str, src+offset, size);
 	ptr->tokens[ptr->size].str[size] = '\0';
@@ -52,108 +272,82 @@ void add_token(Lexer* ptr, char* src, enum TokenType type, int offset, int size)
 }
 
 Lexer lex(char* src, size_t size){
+	return lex_with(src, size, LEX_BEST);
+}
+
+Lexer lex_with(char* src, size_t size, enum Lex_Scanner scanner){
 	Lexer res = {
 		.size = 0,
 		.capacity = 8,
-		.tokens = malloc(8*sizeof(Token)),
+		.tokens = mem_alloc(8*sizeof(Token)),
 		.exit_code = 0,
 	};
 
+	Run_End run_end = pick_run_end(scanner);
 	int line = 1;
-	int inSomething = 0;
-	int something_size = 0;
 	for(size_t i = 0; i < size; i++){
 		char c = src[i];
 
-		if(inSomething == 1){ // in comment
-			if(c != '\n'){
-				continue;
-			}
-			inSomething = 0;
-			continue;
-		}
-		else if(inSomething == 2){ // in int
-			if(isdigit(c)){
-				something_size++;
-				continue;
-			}
-			add_token(&res, src, INTEGER, i-something_size-1, something_size+1);
-			inSomething = 0;
-		}
-		else if(inSomething == 3){ // in identifier
-			if(isalnum(c)){
-				something_size++;
-				continue;
-			}
-			add_token(&res, src, IDENTIFIER, i-something_size-1, something_size+1);
-			inSomething = 0;
-		}
-		else if(inSomething == 4){ // in str
-			if(c != '"'){
-				something_size++;
-				continue;
-			}
-			add_token(&res, src, STRING, i-something_size, something_size);
-			inSomething = 0;
-			continue;
-		}
 		switch(c){
 			case ' ':
 			case '\t':
 			case '\r':
 			{
 				// ignore whitespace
+				i = run_end(src, i+1, size, RUN_SPACE)-1;
 				break;
 			}
 			case '\n':
 			{
-				add_token(&res, src, NEWLINE, i, 1);
+				add_token(&res, src, NEWLINE, i, 1, line);
 				line++;
 				break;
 			}
 			case '+':
 			{
-				add_token(&res, src, PLUS, i, 1);
+				add_token(&res, src, PLUS, i, 1, line);
 				break;
 			}
 			case '-':
 			{
-				add_token(&res, src, MINUS, i, 1);
+				add_token(&res, src, MINUS, i, 1, line);
 				break;
 			}
 			case '*':
 			{
-				add_token(&res, src, STAR, i, 1);
+				add_token(&res, src, STAR, i, 1, line);
 				break;
 			}
 			case ',':
 			{
-				add_token(&res, src, COMMA, i, 1);
+				add_token(&res, src, COMMA, i, 1, line);
 				break;
 			}
 			case '(':
 			{
-				add_token(&res, src, GROUP_START, i, 1);
+				add_token(&res, src, GROUP_START, i, 1, line);
 				break;
 			}
 			case ')':
 			{
-				add_token(&res, src, GROUP_END, i, 1);
+				add_token(&res, src, GROUP_END, i, 1, line);
 				break;
 			}
 			case '/':
 			{
 				if(i+1 < size && src[i+1] == '/'){
-					inSomething = 1;
+					// the newline ending a comment is skipped with it, it doesn't end a statement
+					i = run_end(src, i+2, size, RUN_COMMENT);
+					line++;
 					break;
 				}
-				add_token(&res, src, SLASH, i, 1);
+				add_token(&res, src, SLASH, i, 1, line);
 				break;
 			}
 			case '=':
 			{
 				if(i+1 < size && src[i+1] == '='){
-					add_token(&res, src, EQEQ, i, 2);
+					add_token(&res, src, EQEQ, i, 2, line);
 					i += 2;
 					break;
 				}
@@ -163,38 +357,53 @@ Lexer lex(char* src, size_t size){
 			case '>':
 			{
 				if(i+1 < size && src[i+1] == '='){
-					add_token(&res, src, GTEQ, i, 2);
+					add_token(&res, src, GTEQ, i, 2, line);
 					i += 2;
 					break;
 				}
-				add_token(&res, src, GT, i, 1);
+				add_token(&res, src, GT, i, 1, line);
 				break;
 			}
 			case '<':
 			{
 				if(i+1 < size && src[i+1] == '='){
-					add_token(&res, src, LTEQ, i, 2);
+					add_token(&res, src, LTEQ, i, 2, line);
 					i += 2;
 					break;
 				}
-				add_token(&res, src, LT, i, 1);
+				add_token(&res, src, LT, i, 1, line);
 				break;
 			}
 			default:
 			{
+				// an integer, identifier or string the input ends in the middle of is dropped
 				if(isdigit(c)){
-					something_size = 0;
-					inSomething = 2;
+					size_t end = run_end(src, i+1, size, RUN_DIGITS);
+					if(end < size){
+						add_token(&res, src, INTEGER, i, end-i, line);
+					}
+					i = end-1;
 					break;
 				}
-				else if(isalpha(c)){
-					something_size = 0;
-					inSomething = 3;
+				// _ is allowed so the stdlib's __std names lex
+				else if(isalpha(c) || c == '_'){
+					size_t end = run_end(src, i+1, size, RUN_WORD);
+					if(end < size){
+						add_token(&res, src, IDENTIFIER, i, end-i, line);
+					}
+					i = end-1;
 					break;
 				}
 				else if(c == '"'){
-					something_size = 0;
-					inSomething = 4;
+					size_t end = run_end(src, i+1, size, RUN_STRING);
+					while(end < size && src[end] == '\n'){
+						line++;
+						end = run_end(src, end+1, size, RUN_STRING);
+					}
+					if(end < size){
+						add_token(&res, src, STRING, i+1, end-i-1, line);
+					}
+					i = end;
 					break;
 				}
 				ERROR_LOG(res, "[ERR][line %i] Unknown character found: \'%c\'\n", line, c);
@@ -221,8 +430,8 @@ void print_lexer(Lexer lexer){
 
 void free_lexer(Lexer* lexer){
 	for(int i = 0; i < (int)lexer->size; i++){
-		free(lexer->tokens[i].str);
+		mem_free(lexer->tokens[i].str);
 	}
-	free(lexer->tokens);
+	mem_free(lexer->tokens);
 	lexer->tokens = NULL;
 }
@@ -16,15 +16,21 @@ enum TokenType {
 	IF, ELSE, ELIF, // 22
 	AND, OR, NOT, // 25
 	EXIT, END, // 27
-	FUNC, CALL, // 29
+	FUNC, CALL, RETURN, // 30
+	SH, SPAWN, WAIT, // 33
+	LOAD, EACH, WRITE, // 36
+	PFOR, SNAPSHOT, // 38
+	MAP, PUT, GET, HAS, DELETE, // 43
 
-	NEWLINE // 30
+	NEWLINE // 44
 };
 
 typedef struct {
 	enum TokenType type;
 	char* str;
 	size_t size;
+	// source line the token started on, counting from 1
+	int line;
 } Token;
 
 typedef struct {
@@ -34,7 +40,16 @@ typedef struct {
 	int exit_code;
 } Lexer;
 
+// what lex jumps over comments, strings, spaces and words with, LEX_BEST is the fastest
+// one the CPU has, the rest are there so tests can check each of them finds the same tokens
+enum Lex_Scanner { LEX_BEST, LEX_SCALAR, LEX_SSE2, LEX_AVX2 };
+
 Lexer lex(char* src, size_t size);
+// lex with the scanner forced, one this build doesn't have gets LEX_BEST instead
+// and forcing AVX2 on a CPU without it crashes, check lex_scanner_supported first
+Lexer lex_with(char* src, size_t size, enum Lex_Scanner scanner);
+// 0 when this build or CPU doesn't have the scanner
+int lex_scanner_supported(enum Lex_Scanner scanner);
 void print_lexer(Lexer lexer);
 void free_lexer(Lexer* lexer);
 
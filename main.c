@@ -1,15 +1,58 @@
 #include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
 #include "interpreter.h"
 
 int main(int argc, char** argv){
-	if(argc > 3 || argc < 2){
-		printf("Usage: frosting [file]\nNOTE: Run without args to enter live mode\n");
+	if(argc < 2){
+		printf("Usage: frosting [-n] [file] [debug] [--jit] [--frames count] [--fuel count] [--memory bytes]\nNOTE: Run without args to enter live mode\n");
 	}
-	else if(argc == 2 || argc == 3){
-		FILE* file = fopen(argv[1], "r");
+	else{
+		int debug_mode = 1;
+		int jit = 0;
+		int per_line = 0;
+		size_t frame_limit = 0;
+		size_t fuel = 0;
+		size_t memory_limit = 0;
+		char* path = NULL;
+		for(int i = 1; i < argc; i++){
+			if(strcmp(argv[i], "-n") == 0){
+				per_line = 1;
+				continue;
+			}
+			if(strcmp(argv[i], "--jit") == 0){
+				jit = 1;
+				continue;
+			}
+			if(strcmp(argv[i], "--frames") == 0 && i+1 < argc){
+				frame_limit = strtoul(argv[i+1], NULL, 10);
+				i++;
+				continue;
+			}
+			if(strcmp(argv[i], "--fuel") == 0 && i+1 < argc){
+				fuel = strtoul(argv[i+1], NULL, 10);
+				i++;
+				continue;
+			}
+			if(strcmp(argv[i], "--memory") == 0 && i+1 < argc){
+				memory_limit = strtoul(argv[i+1], NULL, 10);
+				i++;
+				continue;
+			}
+			if(path == NULL){
+				path = argv[i];
+				continue;
+			}
+			debug_mode = strncmp(argv[i], "debug", 5);
+		}
+		if(path == NULL){
+			fprintf(stderr, "[ERR] No file to run\n");
+			return 1;
+		}
+
+		FILE* file = fopen(path, "r");
 		if(file == NULL){
-			fprintf(stderr, "File at %s does not exit\n", argv[1]);
+			fprintf(stderr, "File at %s does not exit\n", path);
 			return 1;
 		}
 		fseek(file, 0, SEEK_END);
@@ -18,7 +61,7 @@ int main(int argc, char** argv){
 		char buffer[size+1];
 		fread(buffer, sizeof(char), size, file);
 		buffer[size] = '\0';
-		return run_code(buffer, size, (argc == 2 ? 1 : strncmp(argv[2], "debug", 5)));
+		return run_code(buffer, size, debug_mode, jit, frame_limit, per_line, fuel, NULL, memory_limit);
 	}
 	return 0;
 }
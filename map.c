@@ -0,0 +1,226 @@
+#include "map.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+// a slot is empty, deleted, or an entry index plus one
+#define SLOT_EMPTY 0
+#define SLOT_DELETED UINT32_MAX
+// old slots moved over by every put and delete while the map is growing
+#define MAP_MOVE_STEP 8
+
+size_t hash_key(enum TokenType key_type, char* key, size_t key_size){
+	size_t hash = 14695981039346656037ULL ^ (size_t)key_type;
+	for(size_t i = 0; i < key_size; i++){
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+Map* new_map(void){
+	Map* map = mem_calloc(1, sizeof(Map));
+	map->entry_capacity = 8;
+	map->entries = mem_alloc(map->entry_capacity*sizeof(Map_Entry));
+	map->slot_capacity = 16;
+	map->slots = mem_calloc(map->slot_capacity, sizeof(uint32_t));
+	return map;
+}
+
+// the slot in slots that has the key, NULL if none of them do
+uint32_t* probe_slots(Map* map, uint32_t* slots, size_t capacity, size_t hash, enum TokenType key_type, char* key, size_t key_size){
+	size_t mask = capacity-1;
+	for(size_t i = hash & mask, probes = 0; probes < capacity; i = (i+1) & mask, probes++){
+		if(slots[i] == SLOT_EMPTY){
+			return NULL;
+		}
+		if(slots[i] == SLOT_DELETED){
+			continue;
+		}
+		Map_Entry* entry = &map->entries[slots[i]-1];
+		if(entry->hash == hash && entry->key_type == key_type && entry->key_size == key_size
+		&& memcmp(entry->key, key, key_size) == 0){
+			return &slots[i];
+		}
+	}
+	return NULL;
+}
+
+uint32_t* find_key(Map* map, size_t hash, enum TokenType key_type, char* key, size_t key_size){
+	uint32_t* slot = probe_slots(map, map->slots, map->slot_capacity, hash, key_type, key, key_size);
+	if(slot == NULL && map->old_slots != NULL){
+		slot = probe_slots(map, map->old_slots, map->old_capacity, hash, key_type, key, key_size);
+	}
+	return slot;
+}
+
+// puts entry index into slots, which never has it already
+void place_entry(Map* map, size_t index){
+	size_t mask = map->slot_capacity-1;
+	size_t i = map->entries[index].hash & mask;
+	while(map->slots[i] != SLOT_EMPTY && map->slots[i] != SLOT_DELETED){
+		i = (i+1) & mask;
+	}
+	if(map->slots[i] == SLOT_EMPTY){
+		map->slots_used++;
+	}
+	map->slots[i] = (uint32_t)index+1;
+}
+
+// moved slots are left deleted so a lookup still probes past them in the old table
+void move_slots(Map* map, size_t count){
+	while(map->old_slots != NULL && count > 0){
+		uint32_t slot = map->old_slots[map->old_next];
+		if(slot != SLOT_EMPTY && slot != SLOT_DELETED){
+			place_entry(map, slot-1);
+			map->old_slots[map->old_next] = SLOT_DELETED;
+		}
+		map->old_next++;
+		count--;
+		if(map->old_next >= map->old_capacity){
+			mem_free(map->old_slots);
+			map->old_slots = NULL;
+		}
+	}
+}
+
+// starts moving into a table big enough that it is at most half full once everything is over
+void grow_slots(Map* map){
+	move_slots(map, map->old_capacity);
+	size_t capacity = map->slot_capacity;
+	while((map->count+1)*2 > capacity){
+		capacity *= 2;
+	}
+	map->old_slots = map->slots;
+	map->old_capacity = map->slot_capacity;
+	map->old_next = 0;
+	map->slots = mem_calloc(capacity, sizeof(uint32_t));
+	map->slot_capacity = capacity;
+	map->slots_used = 0;
+}
+
+// drops the holes deleting left, every index changes so the slots get built again all at once
+void pack_entries(Map* map){
+	size_t count = 0;
+	for(size_t i = 0; i < map->entry_count; i++){
+		if(map->entries[i].key != NULL){
+			map->entries[count] = map->entries[i];
+			count++;
+		}
+	}
+	map->entry_count = count;
+	mem_free(map->old_slots);
+	map->old_slots = NULL;
+	memset(map->slots, 0, map->slot_capacity*sizeof(uint32_t));
+	map->slots_used = 0;
+	for(size_t i = 0; i < map->entry_count; i++){
+		place_entry(map, i);
+	}
+}
+
+Map* copy_map(Map* map){
+	Map* copy = new_map();
+	for(size_t i = map_next(map, 0); i < map->entry_count; i = map_next(map, i+1)){
+		Map_Entry* entry = &map->entries[i];
+		char* key = mem_alloc(sizeof(char)*(entry->key_size+1));
+		memcpy(key, entry->key, entry->key_size+1);
+		char* value = mem_alloc(sizeof(char)*(entry->value_size+1));
+		memcpy(value, entry->value, entry->value_size+1);
+		map_set(copy, entry->key_type, key, entry->key_size, entry->type, value, entry->value_size);
+	}
+	return copy;
+}
+
+void free_map(Map* map){
+	for(size_t i = 0; i < map->entry_count; i++){
+		mem_free(map->entries[i].key);
+		mem_free(map->entries[i].value);
+	}
+	mem_free(map->entries);
+	mem_free(map->slots);
+	mem_free(map->old_slots);
+	mem_free(map);
+}
+
+Map_Entry* map_get(Map* map, enum TokenType key_type, char* key, size_t key_size){
+	uint32_t* slot = find_key(map, hash_key(key_type, key, key_size), key_type, key, key_size);
+	return slot != NULL ? &map->entries[(*slot)-1] : NULL;
+}
+
+void map_set(Map* map, enum TokenType key_type, char* key, size_t key_size, enum TokenType type, char* value, size_t value_size){
+	move_slots(map, MAP_MOVE_STEP);
+	size_t hash = hash_key(key_type, key, key_size);
+	uint32_t* slot = find_key(map, hash, key_type, key, key_size);
+	if(slot != NULL){
+		Map_Entry* entry = &map->entries[(*slot)-1];
+		mem_free(key);
+		mem_free(entry->value);
+		entry->type = type;
+		entry->value = value;
+		entry->value_size = value_size;
+		return;
+	}
+
+	if(map->entry_count >= map->entry_capacity){
+		if(map->count <= map->entry_count/2){
+			pack_entries(map);
+		}
+		else{
+			map->entry_capacity *= 2;
+			map->entries = mem_realloc(map->entries, map->entry_capacity*sizeof(Map_Entry));
+		}
+	}
+	if((map->slots_used+1)*4 > map->slot_capacity*3){
+		grow_slots(map);
+	}
+	map->entries[map->entry_count] = (Map_Entry){
+		.hash = hash,
+		.key_type = key_type,
+		.key = key,
+		.key_size = key_size,
+		.type = type,
+		.value = value,
+		.value_size = value_size,
+	};
+	place_entry(map, map->entry_count);
+	map->entry_count++;
+	map->count++;
+}
+
+int map_delete(Map* map, enum TokenType key_type, char* key, size_t key_size){
+	move_slots(map, MAP_MOVE_STEP);
+	uint32_t* slot = find_key(map, hash_key(key_type, key, key_size), key_type, key, key_size);
+	if(slot == NULL){
+		return 0;
+	}
+	Map_Entry* entry = &map->entries[(*slot)-1];
+	*slot = SLOT_DELETED;
+	mem_free(entry->key);
+	mem_free(entry->value);
+	entry->key = NULL;
+	entry->value = NULL;
+	map->count--;
+	return 1;
+}
+
+size_t map_next(Map* map, size_t index){
+	while(index < map->entry_count && map->entries[index].key == NULL){
+		index++;
+	}
+	return index;
+}
+
+void print_map(FILE* out, Map* map){
+	fprintf(out, "{");
+	const char* separator = "";
+	for(size_t i = map_next(map, 0); i < map->entry_count; i = map_next(map, i+1)){
+		Map_Entry* entry = &map->entries[i];
+		const char* key_quote = entry->key_type == STRING ? "\"" : "";
+		const char* quote = entry->type == STRING ? "\"" : "";
+		fprintf(out, "%s%s%.*s%s: %s%.*s%s", separator,
+			key_quote, (int)entry->key_size, entry->key, key_quote,
+			quote, (int)entry->value_size, entry->value, quote);
+		separator = ", ";
+	}
+	fprintf(out, "}");
+}
@@ -0,0 +1,55 @@
+#ifndef MAP_H
+#define MAP_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "lexer.h"
+
+// keys and values are INTEGER or STRING, an integer key is its digits like an integer var
+typedef struct {
+	// worked out once when the key goes in, growing never hashes a key again
+	size_t hash;
+	enum TokenType key_type;
+	// NULL once the key has been deleted, the entry stays a hole until the entries get packed
+	char* key;
+	size_t key_size;
+	enum TokenType type;
+	char* value;
+	size_t value_size;
+} Map_Entry;
+
+// the entries are kept in the order they went in (which is the order each goes over them),
+// slots is an open addressing table of indexes into them
+// growing moves a few of the old slots over with every put and delete instead of all at once,
+// until it is done a key can still be in old_slots
+typedef struct {
+	Map_Entry* entries;
+	size_t entry_count;
+	size_t entry_capacity;
+	// keys in it, entry_count minus the holes
+	size_t count;
+	uint32_t* slots;
+	size_t slot_capacity;
+	// slots that aren't empty, deleted ones included
+	size_t slots_used;
+	uint32_t* old_slots;
+	size_t old_capacity;
+	// old slots before this one have been moved
+	size_t old_next;
+} Map;
+
+Map* new_map(void);
+Map* copy_map(Map* map);
+void free_map(Map* map);
+// NULL if the key isn't in it, never changes the map so threads can share one to read
+Map_Entry* map_get(Map* map, enum TokenType key_type, char* key, size_t key_size);
+// takes ownership of key and value, which must have come from mem_alloc
+void map_set(Map* map, enum TokenType key_type, char* key, size_t key_size, enum TokenType type, char* value, size_t value_size);
+// 0 if the key wasn't in it
+int map_delete(Map* map, enum TokenType key_type, char* key, size_t key_size);
+// the first entry at or after index that still has its key, entry_count if there isn't one
+size_t map_next(Map* map, size_t index);
+// {"key": value, 1: "value"}, strings get quotes so the key types can be told apart
+void print_map(FILE* out, Map* map);
+
+#endif // MAP_H
@@ -0,0 +1,414 @@
+#define _POSIX_C_SOURCE 200809L
+#include "memory.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// blocks up to SLAB_CLASSES*SLAB_CLASS bytes come out of slabs, one free list per size
+#define SLAB_CLASS 16
+#define SLAB_CLASSES 32
+#define SLAB_SIZE (64*1024)
+
+typedef struct Free_Block {
+	struct Free_Block* next;
+} Free_Block;
+
+typedef struct {
+	Free_Block* free[SLAB_CLASSES];
+	char** slabs;
+	size_t slab_count;
+	size_t slab_capacity;
+	// the part of the newest slab nothing has been handed out from yet
+	char* next;
+	size_t left;
+} Slab_Pool;
+
+// in front of every block, so freeing it needs nothing but the pointer
+// four words keeps what comes after it as aligned as malloc's
+typedef struct Block {
+	Memory* memory;
+	size_t size;
+	// the blocks of a Memory that are still out, so free_memory can take back what nothing freed
+	struct Block* prev;
+	struct Block* next;
+} Block;
+
+typedef struct Mapping {
+	void* data;
+	size_t size;
+	// counted in in_use, see mem_charge_mapping
+	int charged;
+	struct Mapping* next;
+} Mapping;
+
+// each thread's, see use_memory and refuse_over_limit
+__thread Memory* used_memory = NULL;
+__thread jmp_buf* refused_jump = NULL;
+
+// 0 for blocks too big for a slab
+size_t slab_class(size_t size){
+	size_t class = (size+SLAB_CLASS-1)/SLAB_CLASS;
+	return class <= SLAB_CLASSES ? class : 0;
+}
+
+void* slab_alloc(void* context, size_t size){
+	Slab_Pool* pool = context;
+	size_t class = slab_class(size);
+	if(class == 0){
+		return malloc(size);
+	}
+	if(pool->free[class-1] != NULL){
+		Free_Block* block = pool->free[class-1];
+		pool->free[class-1] = block->next;
+		return block;
+	}
+	size_t bytes = class*SLAB_CLASS;
+	if(pool->left < bytes){
+		// whatever was left of the old slab is too small, it just goes unused
+		char* slab = malloc(SLAB_SIZE);
+		if(slab == NULL){
+			return NULL;
+		}
+		if(pool->slab_count >= pool->slab_capacity){
+			pool->slab_capacity *= 2;
+			pool->slabs = realloc(pool->slabs, pool->slab_capacity*sizeof(char*));
+		}
+		pool->slabs[pool->slab_count] = slab;
+		pool->slab_count++;
+		pool->next = slab;
+		pool->left = SLAB_SIZE;
+	}
+	void* block = pool->next;
+	pool->next += bytes;
+	pool->left -= bytes;
+	return block;
+}
+
+void slab_release(void* context, void* ptr, size_t size){
+	Slab_Pool* pool = context;
+	size_t class = slab_class(size);
+	if(class == 0){
+		free(ptr);
+		return;
+	}
+	Free_Block* block = ptr;
+	block->next = pool->free[class-1];
+	pool->free[class-1] = block;
+}
+
+void* slab_resize(void* context, void* ptr, size_t old_size, size_t size){
+	size_t old_class = slab_class(old_size);
+	size_t class = slab_class(size);
+	if(old_class == 0 && class == 0){
+		return realloc(ptr, size);
+	}
+	if(old_class == class){
+		return ptr;
+	}
+	void* moved = slab_alloc(context, size);
+	if(moved == NULL){
+		return NULL;
+	}
+	memcpy(moved, ptr, old_size < size ? old_size : size);
+	slab_release(context, ptr, old_size);
+	return moved;
+}
+
+Memory* new_memory(Allocator* allocator, size_t limit){
+	Memory* memory = calloc(1, sizeof(Memory));
+	memory->limit = limit;
+	pthread_mutex_init(&memory->lock, NULL);
+	if(allocator != NULL){
+		memory->allocator = *allocator;
+		return memory;
+	}
+	Slab_Pool* pool = calloc(1, sizeof(Slab_Pool));
+	pool->slab_capacity = 8;
+	pool->slabs = malloc(pool->slab_capacity*sizeof(char*));
+	memory->slabs = pool;
+	memory->allocator = (Allocator){
+		.alloc = slab_alloc,
+		.resize = slab_resize,
+		.release = slab_release,
+		.context = pool,
+	};
+	return memory;
+}
+
+void free_memory(Memory* memory){
+	if(memory == NULL){
+		return;
+	}
+	if(used_memory == memory){
+		used_memory = NULL;
+	}
+	// anything a run stopped partway through was still holding (or a host never freed)
+	Block* block = memory->blocks;
+	while(block != NULL){
+		Block* next = block->next;
+		memory->allocator.release(memory->allocator.context, block, sizeof(Block)+block->size);
+		block = next;
+	}
+	Mapping* mapping = memory->mappings;
+	while(mapping != NULL){
+		Mapping* next = mapping->next;
+		munmap(mapping->data, mapping->size);
+		free(mapping);
+		mapping = next;
+	}
+	Slab_Pool* pool = memory->slabs;
+	if(pool != NULL){
+		for(size_t i = 0; i < pool->slab_count; i++){
+			free(pool->slabs[i]);
+		}
+		free(pool->slabs);
+		free(pool);
+	}
+	pthread_mutex_destroy(&memory->lock);
+	free(memory);
+}
+
+void use_memory(Memory* memory){
+	used_memory = memory;
+}
+
+jmp_buf* refuse_over_limit(jmp_buf* jump){
+	jmp_buf* outer = refused_jump;
+	refused_jump = jump;
+	return outer;
+}
+
+void lock_memory(Memory* memory){
+	if(memory->shared){
+		pthread_mutex_lock(&memory->lock);
+	}
+}
+
+void unlock_memory(Memory* memory){
+	if(memory->shared){
+		pthread_mutex_unlock(&memory->lock);
+	}
+}
+
+void out_of_memory(size_t size){
+	fprintf(stderr, "[ERR] Out of memory allocating %zu bytes\n", size);
+	abort();
+}
+
+// called with the lock held, a resize both adds its new size and removes its old one
+void count_bytes(Memory* memory, size_t added, size_t removed){
+	memory->in_use += added;
+	memory->in_use -= removed;
+	memory->total += added > removed ? added-removed : 0;
+	if(memory->in_use > memory->peak){
+		memory->peak = memory->in_use;
+	}
+	if(memory->limit > 0 && memory->in_use > memory->limit){
+		memory->over_limit = 1;
+	}
+}
+
+// called with the lock held, going past the limit is only refused when the thread has
+// somewhere to jump to, otherwise count_bytes just notes it
+int refuses(Memory* memory, size_t added, size_t removed){
+	if(memory->limit == 0 || refused_jump == NULL || memory->in_use+added <= memory->limit+removed){
+		return 0;
+	}
+	memory->over_limit = 1;
+	return 1;
+}
+
+// called without the lock, after an allocation was refused or the allocator came back empty
+void refuse(Memory* memory, size_t size){
+	if(refused_jump == NULL){
+		out_of_memory(size);
+	}
+	lock_memory(memory);
+	memory->refused = 1;
+	unlock_memory(memory);
+	longjmp(*refused_jump, 1);
+}
+
+// called with the lock held
+void link_block(Memory* memory, Block* block){
+	block->prev = NULL;
+	block->next = memory->blocks;
+	if(block->next != NULL){
+		block->next->prev = block;
+	}
+	memory->blocks = block;
+}
+
+void unlink_block(Memory* memory, Block* block){
+	if(block->prev != NULL){
+		block->prev->next = block->next;
+	}
+	else{
+		memory->blocks = block->next;
+	}
+	if(block->next != NULL){
+		block->next->prev = block->prev;
+	}
+}
+
+void* mem_alloc(size_t size){
+	Memory* memory = used_memory;
+	size_t bytes = sizeof(Block)+size;
+	Block* block = NULL;
+	if(memory == NULL){
+		block = malloc(bytes);
+		if(block == NULL){
+			out_of_memory(size);
+		}
+	}
+	else{
+		lock_memory(memory);
+		if(!refuses(memory, bytes, 0)){
+			block = memory->allocator.alloc(memory->allocator.context, bytes);
+		}
+		if(block != NULL){
+			count_bytes(memory, bytes, 0);
+			memory->allocations++;
+			link_block(memory, block);
+		}
+		unlock_memory(memory);
+		if(block == NULL){
+			refuse(memory, size);
+		}
+	}
+	block->memory = memory;
+	block->size = size;
+	return block+1;
+}
+
+void* mem_calloc(size_t count, size_t size){
+	// count*size would wrap around to something small, so it's refused like any other too big
+	if(size > 0 && count > SIZE_MAX/size){
+		if(used_memory == NULL){
+			out_of_memory(SIZE_MAX);
+		}
+		refuse(used_memory, SIZE_MAX);
+	}
+	void* ptr = mem_alloc(count*size);
+	memset(ptr, 0, count*size);
+	return ptr;
+}
+
+// a refused resize leaves ptr as it was
+void* mem_realloc(void* ptr, size_t size){
+	if(ptr == NULL){
+		return mem_alloc(size);
+	}
+	Block* block = (Block*)ptr-1;
+	Memory* memory = block->memory;
+	size_t old_bytes = sizeof(Block)+block->size;
+	size_t bytes = sizeof(Block)+size;
+	if(memory == NULL){
+		block = realloc(block, bytes);
+		if(block == NULL){
+			out_of_memory(size);
+		}
+	}
+	else{
+		lock_memory(memory);
+		Block* resized = NULL;
+		if(!refuses(memory, bytes, old_bytes)){
+			// unlinked first, the block may move
+			unlink_block(memory, block);
+			resized = memory->allocator.resize(memory->allocator.context, block, old_bytes, bytes);
+			link_block(memory, resized != NULL ? resized : block);
+		}
+		if(resized != NULL){
+			count_bytes(memory, bytes, old_bytes);
+			memory->allocations++;
+		}
+		unlock_memory(memory);
+		if(resized == NULL){
+			refuse(memory, size);
+		}
+		block = resized;
+	}
+	block->size = size;
+	return block+1;
+}
+
+void mem_free(void* ptr){
+	if(ptr == NULL){
+		return;
+	}
+	Block* block = (Block*)ptr-1;
+	Memory* memory = block->memory;
+	if(memory == NULL){
+		free(block);
+		return;
+	}
+	size_t bytes = sizeof(Block)+block->size;
+	lock_memory(memory);
+	unlink_block(memory, block);
+	memory->allocator.release(memory->allocator.context, block, bytes);
+	count_bytes(memory, 0, bytes);
+	unlock_memory(memory);
+}
+
+// called with the lock held
+void link_mapping(Memory* memory, Mapping* mapping, void* data, size_t size, int charged){
+	mapping->data = data;
+	mapping->size = size;
+	mapping->charged = charged;
+	mapping->next = memory->mappings;
+	memory->mappings = mapping;
+}
+
+void mem_track_mapping(void* data, size_t size){
+	Memory* memory = used_memory;
+	Mapping* mapping = memory != NULL ? malloc(sizeof(Mapping)) : NULL;
+	if(mapping == NULL){
+		return;
+	}
+	lock_memory(memory);
+	link_mapping(memory, mapping, data, size, 0);
+	unlock_memory(memory);
+}
+
+void mem_charge_mapping(void* data, size_t size){
+	Memory* memory = used_memory;
+	if(memory == NULL){
+		return;
+	}
+	Mapping* mapping = malloc(sizeof(Mapping));
+	lock_memory(memory);
+	int refused = mapping == NULL || refuses(memory, size, 0);
+	if(!refused){
+		count_bytes(memory, size, 0);
+		link_mapping(memory, mapping, data, size, 1);
+	}
+	unlock_memory(memory);
+	if(refused){
+		free(mapping);
+		munmap(data, size);
+		refuse(memory, size);
+	}
+}
+
+void mem_untrack_mapping(void* data){
+	Memory* memory = used_memory;
+	if(memory == NULL){
+		return;
+	}
+	lock_memory(memory);
+	Mapping** at = (Mapping**)&memory->mappings;
+	while(*at != NULL && (*at)->data != data){
+		at = &(*at)->next;
+	}
+	if(*at != NULL){
+		Mapping* mapping = *at;
+		*at = mapping->next;
+		if(mapping->charged){
+			count_bytes(memory, 0, mapping->size);
+		}
+		free(mapping);
+	}
+	unlock_memory(memory);
+}
@@ -0,0 +1,71 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+#include <stddef.h>
+#include <setjmp.h>
+#include <pthread.h>
+
+// where a run gets its memory from, a host can hand in its own to keep scripts in its own pools
+// the size of a block is always handed back in so the allocator doesn't have to keep it
+typedef struct {
+	void* (*alloc)(void* context, size_t size);
+	// like realloc, but ptr is never NULL and size never 0
+	void* (*resize)(void* context, void* ptr, size_t old_size, size_t size);
+	void (*release)(void* context, void* ptr, size_t size);
+	void* context;
+} Allocator;
+
+// one run's allocator and what it has used so far, its pfor threads share it
+typedef struct {
+	Allocator allocator;
+	// the most bytes the run may have at once, 0 for no limit
+	size_t limit;
+	size_t in_use;
+	size_t peak;
+	// every byte asked for over the whole run, freed or not
+	size_t total;
+	size_t allocations;
+	// set once an allocation would have gone past the limit
+	int over_limit;
+	// set when an allocation was refused (past the limit or the allocator had nothing left)
+	// and its thread jumped away partway through, nothing the run was building can be trusted
+	// after that so free_memory takes back whatever is still out instead
+	int refused;
+	// only taken while shared is set, which a pfor does around running its threads
+	pthread_mutex_t lock;
+	int shared;
+	// behind the default allocator, NULL when the host gave its own
+	void* slabs;
+	// every block that hasn't been freed, and every file mapping the run still has
+	void* blocks;
+	void* mappings;
+} Memory;
+
+// allocator of NULL gets the default, which hands out small blocks from slabs it keeps
+Memory* new_memory(Allocator* allocator, size_t limit);
+// blocks and file mappings still out get released with it, the slabs all go at once
+void free_memory(Memory* memory);
+// where new blocks on this thread come from from now on (NULL for plain malloc), a block always
+// goes back to the Memory it came from so switching between runs is fine
+void use_memory(Memory* memory);
+
+// while a thread has one set, an allocation there that would go past the limit (or that the
+// allocator can't make) isn't made, the thread jumps here instead with refused set
+// NULL lets allocations past the limit through, it hands back the jump it replaced
+jmp_buf* refuse_over_limit(jmp_buf* jump);
+
+// what the lexer, parser and interpreter use in place of malloc and friends, with no jump set
+// running out of memory altogether prints an error and aborts
+void* mem_alloc(size_t size);
+void* mem_calloc(size_t count, size_t size);
+void* mem_realloc(void* ptr, size_t size);
+void mem_free(void* ptr);
+
+// file mappings are kept with the blocks so free_memory can unmap any a run never got to
+void mem_track_mapping(void* data, size_t size);
+// pages the run maps for itself (jit code) also count against its limit like blocks do, and
+// ones that would be refused are unmapped before the jump
+void mem_charge_mapping(void* data, size_t size);
+// either kind, called before unmapping
+void mem_untrack_mapping(void* data);
+
+#endif // MEMORY_H
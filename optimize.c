@@ -0,0 +1,375 @@
+#include "optimize.h"
+#include "memory.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+Write_Set block_writes(Parser* parser, Expr* exprs, size_t start, size_t end){
+	Write_Set writes = {
+		.names = mem_alloc(8*sizeof(Token*)),
+		.count = 0,
+		.capacity = 8,
+		.everything = 0,
+	};
+	for(size_t i = start; i < end; i++){
+		Node* node = NODE(parser, exprs[i]);
+		Token* name = NULL;
+		if(node->type == TEMP){
+			name = parser->temps[node->as.temp.temp];
+		}
+		else if(node->type == FUNCTION_CALL){
+			struct Expr_Function_Call call = call_of(parser, exprs[i]);
+			if(call.type == WAIT){
+				writes.everything = 1;
+			}
+			// a for, each or pfor sets its own var every time around, put and delete change a map
+			if((call.type == VAR || call.type == FOR || call.type == EACH || call.type == PFOR
+			|| call.type == PUT || call.type == DELETE)
+			&& call.argc >= 1 && NODE(parser, call.argv[0])->type == LITERAL){
+				name = NODE(parser, call.argv[0])->as.literal;
+			}
+		}
+		if(name == NULL || writes_var(&writes, name->str, name->size)){
+			continue;
+		}
+		if(writes.count >= writes.capacity){
+			writes.capacity *= 2;
+			writes.names = mem_realloc(writes.names, writes.capacity*sizeof(Token*));
+		}
+		writes.names[writes.count] = name;
+		writes.count++;
+	}
+	return writes;
+}
+
+int writes_var(Write_Set* writes, char* name, size_t size){
+	if(writes->everything){
+		return 1;
+	}
+	for(size_t i = 0; i < writes->count; i++){
+		if(writes->names[i]->size == size && strncmp(writes->names[i]->str, name, size) == 0){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+void free_write_set(Write_Set* writes){
+	mem_free(writes->names);
+	writes->names = NULL;
+	writes->count = 0;
+}
+
+typedef struct {
+	Parser* parser;
+	Expr* exprs;
+	size_t* blocks;
+	// the new statement list, temps go in ahead of whatever uses them
+	Expr* out;
+	size_t size;
+	size_t capacity;
+	size_t temps;
+	// temps made for the loop being hoisted out of, so the same math only gets one
+	Expr* hoisted;
+	size_t hoisted_count;
+	size_t hoisted_capacity;
+	// operand slots of the statement being searched for repeats
+	Expr** slots;
+	size_t slot_count;
+	size_t slot_capacity;
+	int report;
+} Optimizer;
+
+void emit_statement(Optimizer* opt, Expr expr){
+	if(opt->size >= opt->capacity){
+		opt->capacity *= 2;
+		opt->out = mem_realloc(opt->out, opt->capacity*sizeof(Expr));
+	}
+	opt->out[opt->size] = expr;
+	opt->size++;
+}
+
+Expr strip_parens(Parser* parser, Expr expr){
+	while(NODE(parser, expr)->type == GROUPED){
+		expr = NODE(parser, expr)->as.grouped;
+	}
+	return expr;
+}
+
+// integer math only, anything with a string in it would only ever fall back at its use
+int is_math(Parser* parser, Expr expr){
+	// solve_expr only looks through one set of parens, math in more than that is left as it is
+	Node* node = NODE(parser, expr);
+	if(node->type == GROUPED){
+		node = NODE(parser, node->as.grouped);
+	}
+	switch(node->type){
+		case OPERATION: return is_math(parser, node->as.operation.lhs) && is_math(parser, node->as.operation.rhs);
+		case LITERAL: return node->as.literal->type == INTEGER || node->as.literal->type == IDENTIFIER;
+		case TEMP: return 1;
+		default: return 0;
+	}
+}
+
+int is_invariant(Parser* parser, Expr expr, Write_Set* writes){
+	Node* node = NODE(parser, strip_parens(parser, expr));
+	switch(node->type){
+		case OPERATION: return is_invariant(parser, node->as.operation.lhs, writes) && is_invariant(parser, node->as.operation.rhs, writes);
+		case LITERAL:
+		{
+			Token* literal = node->as.literal;
+			return literal->type != IDENTIFIER || !writes_var(writes, literal->str, literal->size);
+		}
+		case TEMP:
+		{
+			Token* name = parser->temps[node->as.temp.temp];
+			return !writes_var(writes, name->str, name->size);
+		}
+		default: return 0;
+	}
+}
+
+int same_expr(Parser* parser, Expr lhs, Expr rhs){
+	Node* l = NODE(parser, strip_parens(parser, lhs));
+	Node* r = NODE(parser, strip_parens(parser, rhs));
+	if(l->type != r->type){
+		return 0;
+	}
+	switch(l->type){
+		case OPERATION:
+		{
+			return l->as.operation.operator == r->as.operation.operator
+			&& same_expr(parser, l->as.operation.lhs, r->as.operation.lhs)
+			&& same_expr(parser, l->as.operation.rhs, r->as.operation.rhs);
+		}
+		case LITERAL:
+		{
+			Token* a = l->as.literal;
+			Token* b = r->as.literal;
+			return a->type == b->type && a->size == b->size && strncmp(a->str, b->str, a->size) == 0;
+		}
+		case TEMP: return l->as.temp.temp == r->as.temp.temp;
+		default: return 0;
+	}
+}
+
+// non zero if the nodes are full, the math just stays where it is then
+int make_temp(Optimizer* opt, Expr expr, uint32_t line, Expr* temp){
+	Parser* parser = opt->parser;
+	if(parser->node_count >= parser->node_capacity){
+		return 1;
+	}
+	if(parser->temp_count >= parser->temp_capacity){
+		parser->temp_capacity *= 2;
+		parser->temps = mem_realloc(parser->temps, parser->temp_capacity*sizeof(Token*));
+	}
+	char str[24];
+	int size = snprintf(str, sizeof(str), "%%%zu", parser->temp_count);
+	Token* name = mem_alloc(sizeof(Token));
+	name->type = IDENTIFIER;
+	name->size = size;
+	name->line = line;
+	name->str = mem_alloc(sizeof(char)*(size+1));
+	memcpy(name->str, str, size+1);
+	parser->temps[parser->temp_count] = name;
+
+	Node node = {0};
+	node.type = TEMP;
+	node.line = line;
+	node.as.temp.expr = expr;
+	node.as.temp.temp = parser->temp_count;
+	parser->temp_count++;
+	*temp = add_node(parser, node);
+	opt->temps++;
+	return 0;
+}
+
+// swaps the biggest loop invariant pieces of the math in slot for temps set before the loop,
+// whole says slot itself can go (it is an operand, or a for's limit)
+void hoist_math(Optimizer* opt, Expr* slot, Write_Set* writes, int whole){
+	Parser* parser = opt->parser;
+	Expr expr = strip_parens(parser, *slot);
+	Node* node = NODE(parser, expr);
+	if(node->type != OPERATION){
+		return;
+	}
+	if(whole && is_math(parser, expr) && is_invariant(parser, expr, writes)){
+		for(size_t i = 0; i < opt->hoisted_count; i++){
+			if(same_expr(parser, NODE(parser, opt->hoisted[i])->as.temp.expr, expr)){
+				*slot = opt->hoisted[i];
+				return;
+			}
+		}
+		Expr temp = 0;
+		if(make_temp(opt, *slot, node->line, &temp) != 0){
+			return;
+		}
+		if(opt->hoisted_count >= opt->hoisted_capacity){
+			opt->hoisted_capacity *= 2;
+			opt->hoisted = mem_realloc(opt->hoisted, opt->hoisted_capacity*sizeof(Expr));
+		}
+		opt->hoisted[opt->hoisted_count] = temp;
+		opt->hoisted_count++;
+		emit_statement(opt, temp);
+		*slot = temp;
+		return;
+	}
+	hoist_math(opt, &node->as.operation.lhs, writes, 1);
+	hoist_math(opt, &node->as.operation.rhs, writes, 1);
+}
+
+void hoist_loop(Optimizer* opt, size_t start, size_t end){
+	Parser* parser = opt->parser;
+	Write_Set writes = block_writes(parser, opt->exprs, start, end);
+	uint32_t line = NODE(parser, opt->exprs[start])->line;
+	if(opt->report){
+		printf("[DEBG] Loop on line %u sets:", line);
+		if(writes.everything){
+			printf(" everything (it waits)");
+		}
+		for(size_t i = 0; i < writes.count; i++){
+			printf(" %.*s", (int)writes.names[i]->size, writes.names[i]->str);
+		}
+		printf("\n");
+	}
+	if(writes.everything){
+		free_write_set(&writes);
+		return;
+	}
+
+	opt->hoisted_count = 0;
+	for(size_t i = start; i < end; i++){
+		if(NODE(parser, opt->exprs[i])->type != FUNCTION_CALL){
+			continue;
+		}
+		struct Expr_Function_Call call = call_of(parser, opt->exprs[i]);
+		for(size_t j = 0; j < call.argc; j++){
+			// a for works its limit out again every time around, so all of it can go
+			hoist_math(opt, &call.argv[j], &writes, call.type == FOR && j == 1);
+		}
+	}
+	for(size_t i = 0; opt->report && i < opt->hoisted_count; i++){
+		Token* name = parser->temps[NODE(parser, opt->hoisted[i])->as.temp.temp];
+		printf("[DEBG] Hoisted %.*s out of the loop on line %u\n", (int)name->size, name->str, line);
+	}
+	free_write_set(&writes);
+}
+
+void collect_operands(Optimizer* opt, Expr expr){
+	Node* node = NODE(opt->parser, strip_parens(opt->parser, expr));
+	if(node->type != OPERATION){
+		return;
+	}
+	Expr* operands[2] = {&node->as.operation.lhs, &node->as.operation.rhs};
+	for(int i = 0; i < 2; i++){
+		if(opt->slot_count >= opt->slot_capacity){
+			opt->slot_capacity *= 2;
+			opt->slots = mem_realloc(opt->slots, opt->slot_capacity*sizeof(Expr*));
+		}
+		opt->slots[opt->slot_count] = operands[i];
+		opt->slot_count++;
+		collect_operands(opt, *operands[i]);
+	}
+}
+
+// math that shows up more than once in a statement gets worked out once just before it,
+// slots are outermost first so the biggest repeat is the one that gets shared
+void share_repeats(Optimizer* opt, Expr statement){
+	Parser* parser = opt->parser;
+	if(NODE(parser, statement)->type != FUNCTION_CALL){
+		return;
+	}
+	struct Expr_Function_Call call = call_of(parser, statement);
+	if(call.type != VAR && call.type != PRINT && call.type != WRITE && call.type != RETURN){
+		return;
+	}
+	int shared = 1;
+	while(shared){
+		shared = 0;
+		opt->slot_count = 0;
+		for(size_t i = 0; i < call.argc; i++){
+			collect_operands(opt, call.argv[i]);
+		}
+		for(size_t i = 0; i < opt->slot_count && !shared; i++){
+			Expr expr = *opt->slots[i];
+			if(NODE(parser, strip_parens(parser, expr))->type != OPERATION || !is_math(parser, expr)){
+				continue;
+			}
+			size_t uses = 1;
+			for(size_t j = i+1; j < opt->slot_count; j++){
+				uses += same_expr(parser, *opt->slots[j], expr);
+			}
+			if(uses == 1){
+				continue;
+			}
+			Expr temp = 0;
+			if(make_temp(opt, expr, NODE(parser, statement)->line, &temp) != 0){
+				return;
+			}
+			for(size_t j = i; j < opt->slot_count; j++){
+				if(same_expr(parser, *opt->slots[j], expr)){
+					*opt->slots[j] = temp;
+				}
+			}
+			emit_statement(opt, temp);
+			if(opt->report){
+				Token* name = parser->temps[NODE(parser, temp)->as.temp.temp];
+				printf("[DEBG] Shared %.*s between %zu uses on line %u\n", (int)name->size, name->str, uses, NODE(parser, statement)->line);
+			}
+			shared = 1;
+		}
+	}
+}
+
+void optimize_range(Optimizer* opt, size_t start, size_t end){
+	Parser* parser = opt->parser;
+	for(size_t i = start; i < end; i++){
+		Expr statement = opt->exprs[i];
+		Node* node = NODE(parser, statement);
+		if(node->type == FUNCTION_CALL && opt->blocks[i] < end
+		&& (node->as.function_call.type == FOR || node->as.function_call.type == WHILE
+		|| node->as.function_call.type == EACH || node->as.function_call.type == PFOR)){
+			// outer loops first, whatever they hoist is out of the inner ones too
+			size_t loop_end = opt->blocks[i];
+			hoist_loop(opt, i, loop_end);
+			emit_statement(opt, statement);
+			optimize_range(opt, i+1, loop_end);
+			emit_statement(opt, opt->exprs[loop_end]);
+			i = loop_end;
+			continue;
+		}
+		share_repeats(opt, statement);
+		emit_statement(opt, statement);
+	}
+}
+
+size_t optimize_statements(Parser* parser, Expr** exprs, size_t* size, size_t* capacity, size_t* blocks, int report){
+	Optimizer opt = {
+		.parser = parser,
+		.exprs = *exprs,
+		.blocks = blocks,
+		.out = mem_alloc((*size+8)*sizeof(Expr)),
+		.size = 0,
+		.capacity = *size+8,
+		.temps = 0,
+		.hoisted = mem_alloc(8*sizeof(Expr)),
+		.hoisted_count = 0,
+		.hoisted_capacity = 8,
+		.slots = mem_alloc(8*sizeof(Expr*)),
+		.slot_count = 0,
+		.slot_capacity = 8,
+		.report = report,
+	};
+	optimize_range(&opt, 0, *size);
+	mem_free(opt.hoisted);
+	mem_free(opt.slots);
+	if(opt.temps == 0){
+		mem_free(opt.out);
+		return 0;
+	}
+	mem_free(*exprs);
+	*exprs = opt.out;
+	*size = opt.size;
+	*capacity = opt.capacity;
+	return opt.temps;
+}
@@ -0,0 +1,29 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+#include <stddef.h>
+#include "lexer.h"
+#include "parser.h"
+
+// the vars a block of statements can set, a call can't touch the caller's vars so only the
+// block's own statements count
+typedef struct {
+	Token** names;
+	size_t count;
+	size_t capacity;
+	// a wait sets the vars of every spawn before it, so it counts as setting anything
+	int everything;
+} Write_Set;
+
+// exprs[start] up to (not including) exprs[end]
+Write_Set block_writes(Parser* parser, Expr* exprs, size_t start, size_t end);
+int writes_var(Write_Set* writes, char* name, size_t size);
+void free_write_set(Write_Set* writes);
+
+// math in a loop that reads nothing the loop sets gets worked out once before the loop, and
+// math repeated within a statement gets worked out once before it, both into TEMP statements
+// (temps are named %0, %1, ... which no program can use) whose value the uses read back
+// blocks is what match_blocks gives for exprs, the list gets replaced when anything moves and
+// the number of temps made is returned, report prints what the loops set and what moved
+size_t optimize_statements(Parser* parser, Expr** exprs, size_t* size, size_t* capacity, size_t* blocks, int report);
+
+#endif // OPTIMIZE_H
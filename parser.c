@@ -1,111 +1,132 @@
 #include "parser.h"
+#include "memory.h"
 #include "lexer.h"
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
 
-void add_expression(Expr** exprs, size_t* size, size_t* capacity, Expr expr){
-	if(capacity != NULL){
-		if(*size >= *capacity){
-			*capacity *= 2;
-			*exprs = realloc((*exprs), (*capacity)*sizeof(Expr));
-		}
+Expr add_node(Parser* res, Node node){
+	if(res->node_count >= res->node_capacity){
+		ERROR_LOG((*res), "[ERR] Ran out of room for expression nodes\n");
+		return 0;
+	}
+	res->nodes[res->node_count] = node;
+	res->node_count++;
+	return (Expr)(res->node_count-1);
+}
+
+// where expressions are going, the statement list or the args of the call being filled in
+// (that call's args are always the last ones in parser.args so they can grow in place)
+typedef struct {
+	Expr** exprs;
+	size_t* size;
+	size_t* capacity;
+	struct Node_Call* call;
+} Expr_List;
+
+size_t list_count(Expr_List list){
+	return list.call != NULL ? list.call->argc : *list.size;
+}
+
+Expr* list_at(Parser* res, Expr_List list, size_t index){
+	if(list.call != NULL){
+		return &res->args[list.call->first+index];
 	}
-	else{
-		if(*size >= 8){
-			fprintf(stderr, "[ERR] Out of bounds for fixed size expr array\n");
+	return &(*list.exprs)[index];
+}
+
+void add_expression(Parser* res, Expr_List list, Expr expr){
+	if(list.call != NULL){
+		if(res->arg_count >= res->arg_capacity){
+			ERROR_LOG((*res), "[ERR] Ran out of room for call args\n");
 			return;
 		}
+		res->args[res->arg_count] = expr;
+		res->arg_count++;
+		list.call->argc++;
+		return;
 	}
-	(*exprs)[*size] = expr;
-	*size = (*size) + 1;
+	if(*list.size >= *list.capacity){
+		*list.capacity *= 2;
+		*list.exprs = mem_realloc((*list.exprs), (*list.capacity)*sizeof(Expr));
+	}
+	(*list.exprs)[*list.size] = expr;
+	*list.size = (*list.size) + 1;
 }
 
-Parser parse(Lexer lexer){
-	Parser res = {
-		.size = 0,
-		.capacity = 8,
-		.exprs = malloc(8*sizeof(Expr)),
-		.function_count = 0,
-		.function_capacity = 8,
-		.functions = malloc(8*sizeof(Function)),
-		.exit_code = 0,
-	};
+void drop_last_expression(Parser* res, Expr_List list){
+	if(list.call != NULL){
+		list.call->argc--;
+		res->arg_count--;
+		return;
+	}
+	*list.size = (*list.size) - 1;
+}
 
-	int inFunction = 0;
-	int skipEnd = 0;
+// parses the statements in the given tokens onto list, used for the top level and for
+// function bodies the first time they get called
+void parse_statements(Parser* res, Lexer lexer, Expr** list, size_t* list_size, size_t* list_capacity){
 	int savingRHS = 0;
 	int inFunctionCall = 0;
 
 	for(size_t i = 0; i < lexer.size; i++){
 		Token token = lexer.tokens[i];
-		Expr* exprs = NULL;
-		size_t* size = NULL;
-		size_t* capacity = NULL;
-		if(inFunction == 0){
-			exprs = res.exprs;
-			size = &res.size;
-			capacity = &res.capacity;
-		}
-		else{
-			exprs = res.functions[res.function_count].exprs;
-			size = &res.functions[res.function_count].size;
-			capacity = &res.functions[res.function_count].capacity;
-		}
-		if(exprs == NULL || size == NULL || capacity == NULL){
-			ERROR_LOG(res, "[ERR] Failed to get the expression list details\n");
-			break;
-		}
-		if(inFunctionCall == 1){
-			size_t t = (*size)-1;
-			size = &exprs[t].as.function_call->argc;
-			exprs = exprs[t].as.function_call->argv;
-			capacity = NULL;
+		// pointer to the list itself so growing it updates the parser
+		Expr_List exprs = {
+			.exprs = list,
+			.size = list_size,
+			.capacity = list_capacity,
+			.call = NULL,
+		};
+		// 1 is the args of the last statement, 2 is a call nested in them (`var x call f y`)
+		for(int depth = 0; depth < inFunctionCall; depth++){
+			Expr last = *list_at(res, exprs, list_count(exprs)-1);
+			exprs.call = &NODE(res, last)->as.function_call;
 		}
 		switch(token.type){
 			case NEWLINE:
 			{
-				if(inFunctionCall == 1){
-					inFunctionCall = 0;
-				}
+				inFunctionCall = 0;
 				break;
 			}
 			case INTEGER:
 			case STRING:
 			{
-				if((i >= 1 && (lexer.tokens[i-1].type >= GROUP_START && lexer.tokens[i-1].type <= COMMA))
-				|| (i+1 < lexer.size && (lexer.tokens[i+1].type >= GROUP_START && lexer.tokens[i+1].type <= COMMA))){
+				if((i >= 1 && (lexer.tokens[i-1].type >= EQEQ && lexer.tokens[i-1].type <= SLASH))
+				|| (i+1 < lexer.size && (lexer.tokens[i+1].type >= EQEQ && lexer.tokens[i+1].type <= SLASH))){
 					break;
 				}
-				Expr expr = {0};
-				expr.type = LITERAL;
-				expr.as.literal = &lexer.tokens[i];
-				add_expression(&exprs, size, capacity, expr);
+				Node node = {0};
+				node.type = LITERAL;
+				node.line = token.line;
+				node.as.literal = &lexer.tokens[i];
+				add_expression(res, exprs, add_node(res, node));
 				break;
 			}
 			case IDENTIFIER:
 			{
-				if((i >= 1 && (lexer.tokens[i-1].type >= GROUP_START && lexer.tokens[i-1].type <= COMMA))
-				|| (i+1 < lexer.size && (lexer.tokens[i+1].type >= GROUP_START && lexer.tokens[i+1].type <= COMMA))){
+				if((i >= 1 && (lexer.tokens[i-1].type >= EQEQ && lexer.tokens[i-1].type <= SLASH))
+				|| (i+1 < lexer.size && (lexer.tokens[i+1].type >= EQEQ && lexer.tokens[i+1].type <= SLASH))){
 					break;
 				}
-				Expr expr = {0};
-				expr.type = LITERAL;
-				expr.as.literal = &lexer.tokens[i];
-				add_expression(&exprs, size, capacity, expr);
+				Node node = {0};
+				node.type = LITERAL;
+				node.line = token.line;
+				node.as.literal = &lexer.tokens[i];
+				add_expression(res, exprs, add_node(res, node));
 				break;
 			}
 			case EQEQ: case LTEQ: case GTEQ: case LT: case GT:
 			case PLUS: case MINUS: case STAR: case SLASH:
 			{
-				Expr expr = {0};
-				expr.type = OPERATION;
-				expr.as.operation = malloc(sizeof(struct Expr_Op));
-				expr.as.operation->operator = token.type;
+				Node node = {0};
+				node.type = OPERATION;
+				node.line = token.line;
+				node.as.operation.operator = token.type;
 
 				if(i == 0 || i+1 >= lexer.size){
-					ERROR_LOG(res, "[ERR] Operation expression cannot be the first or last token\n");
+					ERROR_LOG((*res), "[ERR] Operation expression cannot be the first or last token\n");
 					break;
 				}
 
@@ -113,17 +134,19 @@ Parser parse(Lexer lexer){
 				if(lexer.tokens[i-1].type == IDENTIFIER
 				|| lexer.tokens[i-1].type == INTEGER
 				|| lexer.tokens[i-1].type == STRING){
-					expr.as.operation->lhs.type = LITERAL;
-					expr.as.operation->lhs.as.literal = &lexer.tokens[i-1];
+					Node lhs = {0};
+					lhs.type = LITERAL;
+					lhs.line = token.line;
+					lhs.as.literal = &lexer.tokens[i-1];
+					node.as.operation.lhs = add_node(res, lhs);
 				}
-				else if(lexer.tokens[i-1].type == GROUP_END){
-					expr.as.operation->lhs.type = GROUPED;
-					expr.as.operation->lhs.as.grouped = malloc(sizeof(struct Expr_Group));
-					expr.as.operation->lhs.as.grouped->expr = exprs[(*size)-1].as.grouped->expr;
-					*size = (*size) - 1;
+				else if(lexer.tokens[i-1].type == GROUP_END && list_count(exprs) > 0){
+					// the group was already added as its own expression, it moves into the operation
+					node.as.operation.lhs = *list_at(res, exprs, list_count(exprs)-1);
+					drop_last_expression(res, exprs);
 				}
 				else{
-					ERROR_LOG(res, "[ERR] Operation expression does not support token type %i\n", lexer.tokens[i-1].type);
+					ERROR_LOG((*res), "[ERR] Operation expression does not support token type %i\n", lexer.tokens[i-1].type);
 					break;
 				}
 
@@ -131,154 +154,270 @@ Parser parse(Lexer lexer){
 				if(lexer.tokens[i+1].type == IDENTIFIER
 				|| lexer.tokens[i+1].type == INTEGER
 				|| lexer.tokens[i+1].type == STRING){
-					expr.as.operation->rhs.type = LITERAL;
-					expr.as.operation->rhs.as.literal = &lexer.tokens[i+1];
+					Node rhs = {0};
+					rhs.type = LITERAL;
+					rhs.line = token.line;
+					rhs.as.literal = &lexer.tokens[i+1];
+					node.as.operation.rhs = add_node(res, rhs);
 					i++;
 				}
 				else if(lexer.tokens[i+1].type == GROUP_START){
 					savingRHS = 1;
 				}
 				else{
-					ERROR_LOG(res, "[ERR] Operation expression does not support token type %i\n", lexer.tokens[i+1].type);
+					ERROR_LOG((*res), "[ERR] Operation expression does not support token type %i\n", lexer.tokens[i+1].type);
 					break;
 				}
 
-				add_expression(&exprs, size, capacity, expr);
+				add_expression(res, exprs, add_node(res, node));
 
 				break;
 			}
 			case GROUP_END:
 			{
-				Expr expr = {0};
-				expr.type = GROUPED;
-				if((*size) == 0){
-					ERROR_LOG(res, "[ERR] Group expression requires something inside of it\n");
+				Node node = {0};
+				node.type = GROUPED;
+				node.line = token.line;
+				size_t count = list_count(exprs);
+				if(count == 0){
+					ERROR_LOG((*res), "[ERR] Group expression requires something inside of it\n");
 					break;
 				}
-				expr.as.grouped = malloc(sizeof(struct Expr_Group));
-				expr.as.grouped->expr = exprs[(*size)-1];
-				if(savingRHS == 1){
-					exprs[(*size)-2].as.operation->rhs = expr;
-					*size = (*size)-1;
+				node.as.grouped = *list_at(res, exprs, count-1);
+				Expr group = add_node(res, node);
+				if(savingRHS == 1 && count >= 2){
+					NODE(res, *list_at(res, exprs, count-2))->as.operation.rhs = group;
+					drop_last_expression(res, exprs);
 					savingRHS = 0;
 					break;
 				}
-				exprs[(*size)-1] = expr;
+				*list_at(res, exprs, count-1) = group;
 				break;
 			}
 			default:
 			{
-				if(token.type >= VAR && token.type <= CALL){
+				if(token.type >= VAR && token.type < NEWLINE){
 					if(token.type == FUNC){
+						if(list != &res->exprs){
+							ERROR_LOG((*res), "[ERR] Functions cannot be made inside other functions\n");
+							break;
+						}
 						Function function = {
 							.name = NULL,
 							.size = 0,
-							.capacity = 8,
-							.exprs = malloc(8*sizeof(Expr)),
+							.capacity = 0,
+							.exprs = NULL,
 							.argc = 0,
 							.arg_capacity = 8,
-							.argv = malloc(8*sizeof(Token)),
+							.argv = mem_alloc(8*sizeof(Token)),
+							.parsed = 0,
 						};
 						if(i+1 < lexer.size && lexer.tokens[i+1].type == IDENTIFIER){
 							function.name_size = lexer.tokens[i+1].size;
-							function.name = malloc((function.name_size+1)*sizeof(char));
+							function.name = mem_alloc((function.name_size+1)*sizeof(char));
 							strncpy(function.name, lexer.tokens[i+1].str, lexer.tokens[i+1].size);
 							function.name[function.name_size] = '\0';
 						}
 						else{
-							ERROR_LOG(res, "Function definitions require a name after the func keyword\n");
+							ERROR_LOG((*res), "Function definitions require a name after the func keyword\n");
+							mem_free(function.argv);
 							break;
 						}
 						i += 2;
 						while(i < lexer.size && lexer.tokens[i].type != NEWLINE){
 							if(function.argc >= function.arg_capacity){
 								function.arg_capacity *= 2;
-								function.argv = realloc(function.argv, function.arg_capacity*sizeof(Token));
+								function.argv = mem_realloc(function.argv, function.arg_capacity*sizeof(Token));
 							}
 							function.argv[function.argc] = lexer.tokens[i];
 							function.argc++;
 							i++;
 						}
 						if(i >= lexer.size){
-							ERROR_LOG(res, "[ERR] Unbounded arguments in function declaration for %.*s\n", (int)function.name_size, function.name);
+							ERROR_LOG((*res), "[ERR] Unbounded arguments in function declaration for %.*s\n", (int)function.name_size, function.name);
+							mem_free(function.name);
+							mem_free(function.argv);
 							break;
 						}
-						res.functions[res.function_count] = function;
-						inFunction = 1;
-						break;
-					}
-					if(token.type == END){
-						if(inFunction == 1 && skipEnd == 0){
-							res.function_count++;
-							if(res.function_count >= res.function_capacity){
-								res.function_capacity *= 2;
-								res.functions = realloc(res.functions, res.function_capacity*sizeof(Function));
+
+						// only find where the body ends, it gets parsed when it is first called
+						size_t body_end = i+1;
+						int depth = 0;
+						while(body_end < lexer.size){
+							enum TokenType type = lexer.tokens[body_end].type;
+							if(type == FOR || type == WHILE || type == IF || type == EACH || type == PFOR){
+								depth++;
 							}
-							inFunction = 0;
+							else if(type == END){
+								if(depth == 0){
+									break;
+								}
+								depth--;
+							}
+							body_end++;
+						}
+						if(body_end >= lexer.size){
+							ERROR_LOG((*res), "[ERR] Function %.*s is missing its end\n", (int)function.name_size, function.name);
+							mem_free(function.name);
+							mem_free(function.argv);
 							break;
 						}
-						skipEnd = 0;
+						function.body = lexer.tokens+i+1;
+						function.body_size = body_end-(i+1);
+						i = body_end;
+
+						if(res->function_count >= res->function_capacity){
+							res->function_capacity *= 2;
+							res->functions = mem_realloc(res->functions, res->function_capacity*sizeof(Function));
+						}
+						res->functions[res->function_count] = function;
+						res->function_count++;
+						break;
 					}
-					if(token.type == IF || token.type == FOR || token.type == WHILE){
-						skipEnd = 1;
+					if(inFunctionCall >= 2 || (inFunctionCall == 1 && token.type != CALL && token.type != SH && token.type != LOAD
+					&& token.type != MAP && token.type != GET && token.type != HAS)){
+						ERROR_LOG((*res), "[ERR] Only one call, sh, load, map, get or has can be used inside another statement\n");
+						break;
 					}
-					Expr expr = {0};
-					expr.type = FUNCTION_CALL;
-					expr.as.function_call = malloc(sizeof(struct Expr_Function_Call));
-
-					expr.as.function_call->type = token.type;
-					expr.as.function_call->argc = 0;
-					expr.as.function_call->argv = malloc(sizeof(Expr)*8);
-					inFunctionCall = 1;
-
-					add_expression(&exprs, size, capacity, expr);
+					Node node = {0};
+					node.type = FUNCTION_CALL;
+					node.line = token.line;
+					node.as.function_call.type = token.type;
+					node.as.function_call.argc = 0;
+					Expr call = add_node(res, node);
+					add_expression(res, exprs, call);
+					// its args start right after wherever this call itself ended up
+					NODE(res, call)->as.function_call.first = res->arg_count;
+					inFunctionCall++;
 				}
 				break;
 			}
 		};
 	}
+}
+
+Parser parse(Lexer lexer){
+	Parser res = {
+		.size = 0,
+		.capacity = 8,
+		.exprs = mem_alloc(8*sizeof(Expr)),
+		.function_count = 0,
+		.function_capacity = 8,
+		.functions = mem_alloc(8*sizeof(Function)),
+		.node_count = 0,
+		.node_capacity = 3*lexer.size+1,
+		.arg_count = 0,
+		.arg_capacity = 2*lexer.size+1,
+		.temp_count = 0,
+		.temp_capacity = 8,
+		.exit_code = 0,
+	};
+	res.nodes = mem_alloc(res.node_capacity*sizeof(Node));
+	res.args = mem_alloc(res.arg_capacity*sizeof(Expr));
+	res.temps = mem_alloc(res.temp_capacity*sizeof(Token*));
+
+	parse_statements(&res, lexer, &res.exprs, &res.size, &res.capacity);
+
+	return res;
+}
+
+int parse_function(Parser* parser, Function* function){
+	if(function->parsed){
+		return 0;
+	}
+	Lexer body = {
+		.tokens = function->body,
+		.size = function->body_size,
+	};
+	int exit_code = parser->exit_code;
+	parser->exit_code = 0;
+	function->size = 0;
+	function->capacity = 8;
+	function->exprs = mem_alloc(8*sizeof(Expr));
+	parse_statements(parser, body, &function->exprs, &function->size, &function->capacity);
+	function->parsed = 1;
 
+	int res = parser->exit_code;
+	parser->exit_code = exit_code;
 	return res;
 }
 
-void print_expression(int indents, Expr expr){
+int find_function(Parser parser, Token* name){
+	for(size_t j = 0; j < parser.function_count; j++){
+		if(parser.functions[j].name_size == name->size && strncmp(name->str, parser.functions[j].name, name->size) == 0){
+			return (int)j;
+		}
+	}
+	return -1;
+}
+
+struct Expr_Function_Call call_of(Parser* parser, Expr expr){
+	struct Node_Call* node = &NODE(parser, expr)->as.function_call;
+	struct Expr_Function_Call call = {
+		.type = node->type,
+		.argv = &parser->args[node->first],
+		.argc = node->argc,
+	};
+	return call;
+}
+
+void print_expression(Parser* parser, int indents, Expr expr){
 	char str[indents+1];
 	for(int i = 0; i < indents; i++){
 		str[i] = ' ';
 	}
 	str[indents] = '\0';
-	switch(expr.type){
+	Node* node = NODE(parser, expr);
+	switch(node->type){
 		case OPERATION:
 		{
-			print_expression(indents, expr.as.operation->lhs);
-			printf("%sOperation: %i\n", str, expr.as.operation->operator);
-			print_expression(indents, expr.as.operation->rhs);
+			print_expression(parser, indents, node->as.operation.lhs);
+			printf("%sOperation: %i\n", str, node->as.operation.operator);
+			print_expression(parser, indents, node->as.operation.rhs);
 			break;
 		}
 		case LITERAL:
 		{
-			printf("%sLiteral: %.*s\n", str, (int)expr.as.literal->size, expr.as.literal->str);
+			printf("%sLiteral: %.*s\n", str, (int)node->as.literal->size, node->as.literal->str);
 			break;
 		}
 		case GROUPED:
 		{
 			printf("%s(\n", str);
-			print_expression(indents+1, expr.as.grouped->expr);
+			print_expression(parser, indents+1, node->as.grouped);
 			printf("%s)\n", str);
 			break;
 		}
 		case FUNCTION_CALL:
 		{
-			printf("%s%i w/ args:{\n", str, expr.as.function_call->type);
-			for(size_t i = 0; i < expr.as.function_call->argc; i++){
-				print_expression(indents+1, expr.as.function_call->argv[i]);
+			struct Expr_Function_Call call = call_of(parser, expr);
+			printf("%s%i w/ args:{\n", str, call.type);
+			for(size_t i = 0; i < call.argc; i++){
+				print_expression(parser, indents+1, call.argv[i]);
 			}
 			printf("%s}\n", str);
+			break;
+		}
+		case TEMP:
+		{
+			Token* name = parser->temps[node->as.temp.temp];
+			printf("%sTemp %.*s: (\n", str, (int)name->size, name->str);
+			print_expression(parser, indents+1, node->as.temp.expr);
+			printf("%s)\n", str);
+			break;
 		}
 		default: break;
 	}
 }
 
+void print_statements(Parser* parser, Expr* exprs, size_t size){
+	for(size_t i = 0; i < size; i++){
+		printf("Expr %i (type %i): [\n", (int)i, NODE(parser, exprs[i])->type);
+		print_expression(parser, 1, exprs[i]);
+		printf("]\n");
+	}
+}
+
 void print_parser(Parser parser){
 	if(parser.exprs == NULL && parser.functions == NULL){
 		printf("[DEBG] Parser is empty\n");
@@ -286,69 +425,114 @@ void print_parser(Parser parser){
 	}
 	printf("--Parser--\n");
 	printf("Global\n");
-	for(size_t i = 0; i < parser.size; i++){
-		printf("Expr %i (type %i): [\n", (int)i, parser.exprs[i].type);
-		print_expression(1, parser.exprs[i]);
-		printf("]\n");
-	}
+	print_statements(&parser, parser.exprs, parser.size);
 	for(size_t i = 0; i < parser.function_count; i++){
 		printf("(func %.*s) w/ args:{ ", (int)parser.functions[i].name_size, parser.functions[i].name);
 		for(size_t j = 0; j < parser.functions[i].argc; j++){
 			printf("%.*s ", (int)parser.functions[i].argv[j].size, parser.functions[i].argv[j].str);
 		}
 		printf("}\n");
-		for(size_t j = 0; j < parser.functions[i].size; j++){
-			printf("Expr %i (type %i): [\n", (int)j, parser.functions[i].exprs[j].type);
-			print_expression(1, parser.functions[i].exprs[j]);
-			printf("]\n");
+		if(!parser.functions[i].parsed){
+			printf("(body of %zu tokens not parsed yet)\n", parser.functions[i].body_size);
+			continue;
 		}
+		print_statements(&parser, parser.functions[i].exprs, parser.functions[i].size);
 	}
 }
 
-void free_expression(Expr* expr){
-	switch(expr->type){
-		case LITERAL:
-		{
-			// the token gets freed by the lexer
-			expr->as.literal = NULL;
-			break;
-		}
-		case OPERATION:
-		{
-			free_expression(&expr->as.operation->lhs);
-			free_expression(&expr->as.operation->rhs);
-			free(expr->as.operation);
-			break;
+void mark_called(Parser* parser, Token* name, int* reachable, int* queue, size_t* queue_size){
+	int index = find_function(*parser, name);
+	if(index < 0 || reachable[index]){
+		return;
+	}
+	reachable[index] = 1;
+	queue[*queue_size] = index;
+	*queue_size = (*queue_size) + 1;
+}
+
+void mark_calls_in_expression(Parser* parser, Expr expr, int* reachable, int* queue, size_t* queue_size){
+	if(NODE(parser, expr)->type != FUNCTION_CALL){
+		return;
+	}
+	struct Expr_Function_Call call = call_of(parser, expr);
+	if(call.type == CALL && call.argc >= 1 && NODE(parser, call.argv[0])->type == LITERAL){
+		mark_called(parser, NODE(parser, call.argv[0])->as.literal, reachable, queue, queue_size);
+	}
+	for(size_t i = 0; i < call.argc; i++){
+		mark_calls_in_expression(parser, call.argv[i], reachable, queue, queue_size);
+	}
+}
+
+void free_function(Function* function){
+	mem_free(function->name);
+	mem_free(function->argv);
+	// its nodes stay in parser.nodes, they all go when the parser does
+	mem_free(function->exprs);
+}
+
+void prune_functions(Parser* parser, int report){
+	if(parser->function_count == 0){
+		return;
+	}
+	int* reachable = mem_calloc(parser->function_count, sizeof(int));
+	int* queue = mem_alloc(sizeof(int)*parser->function_count);
+	size_t queue_size = 0;
+	for(size_t i = 0; i < parser->size; i++){
+		mark_calls_in_expression(parser, parser->exprs[i], reachable, queue, &queue_size);
+	}
+	for(size_t i = 0; i < queue_size; i++){
+		Function* function = &parser->functions[queue[i]];
+		if(function->parsed){
+			for(size_t j = 0; j < function->size; j++){
+				mark_calls_in_expression(parser, function->exprs[j], reachable, queue, &queue_size);
+			}
+			continue;
 		}
-		case GROUPED:
-		{
-			free_expression(&expr->as.grouped->expr);
-			free(expr->as.grouped);
-			break;
+		// unparsed bodies only need their tokens scanned for `call name`
+		for(size_t j = 0; j+1 < function->body_size; j++){
+			if(function->body[j].type == CALL && function->body[j+1].type == IDENTIFIER){
+				mark_called(parser, &function->body[j+1], reachable, queue, &queue_size);
+			}
 		}
-		case FUNCTION_CALL:
-		{
-			for(size_t i = 0; i < expr->as.function_call->argc; i++){
-				free_expression(&expr->as.function_call->argv[i]);
+	}
+
+	size_t kept = 0;
+	for(size_t i = 0; i < parser->function_count; i++){
+		if(!reachable[i]){
+			if(report){
+				printf("[DEBG] Pruned function %.*s, nothing calls it\n", (int)parser->functions[i].name_size, parser->functions[i].name);
 			}
-			free(expr->as.function_call->argv);
+			free_function(&parser->functions[i]);
+			continue;
 		}
-		default: break;
+		parser->functions[kept] = parser->functions[i];
+		kept++;
 	}
+	parser->function_count = kept;
+	if(kept < parser->function_capacity/2 && kept > 0){
+		parser->function_capacity = kept;
+		parser->functions = mem_realloc(parser->functions, parser->function_capacity*sizeof(Function));
+	}
+	mem_free(reachable);
+	mem_free(queue);
 }
 
 void free_parser(Parser* parser){
-	for(size_t i = 0; i < parser->size; i++){
-		free_expression(&parser->exprs[i]);
-	}
 	for(size_t i = 0; i < parser->function_count; i++){
-		free(parser->functions[i].name);
-		for(size_t j = 0; j < parser->functions[i].size; j++){
-			free_expression(&parser->functions[i].exprs[j]);
-		}
+		free_function(&parser->functions[i]);
 	}
-	free(parser->functions);
+	mem_free(parser->functions);
 	parser->functions = NULL;
-	free(parser->exprs);
+	mem_free(parser->exprs);
 	parser->exprs = NULL;
+	mem_free(parser->nodes);
+	parser->nodes = NULL;
+	mem_free(parser->args);
+	parser->args = NULL;
+	for(size_t i = 0; i < parser->temp_count; i++){
+		mem_free(parser->temps[i]->str);
+		mem_free(parser->temps[i]);
+	}
+	mem_free(parser->temps);
+	parser->temps = NULL;
 }
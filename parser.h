@@ -1,6 +1,7 @@
 #ifndef PARSER_H
 #define PARSER_H
 #include <stddef.h>
+#include <stdint.h>
 #include "lexer.h"
 
 enum ExprType {
@@ -8,33 +9,49 @@ enum ExprType {
 	GROUPED,
 	OPERATION,
 	FUNCTION_CALL, // variables are just calling a `var` function
+	TEMP, // math worked out ahead of where it is used, made by the optimizer
 };
 
-struct Expr_Group;
-struct Expr_Op;
-struct Expr_Function_Call;
-struct Expr_Var_Set;
+// every expression is a node in parser.nodes and points at others by index, so the
+// nodes of a statement sit next to each other instead of each being its own malloc
+typedef uint32_t Expr;
 
-union ExprAs {
+struct Node_Op {
+	Expr lhs;
+	Expr rhs;
+	enum TokenType operator;
+};
+struct Node_Call {
+	enum TokenType type;
+	// the args are parser.args[first] up to first+argc
+	uint32_t first;
+	uint32_t argc;
+};
+
+// as a statement it works expr out into the temp, as an operand it reads the temp back
+// (or works expr out itself when the temp couldn't be set)
+struct Node_Temp {
+	Expr expr;
+	// into parser.temps
+	uint32_t temp;
+};
+
+union NodeAs {
 	Token* literal;
-	struct Expr_Group* grouped;
-	struct Expr_Op* operation;
-	struct Expr_Function_Call* function_call;
+	Expr grouped;
+	struct Node_Op operation;
+	struct Node_Call function_call;
+	struct Node_Temp temp;
 };
 
 typedef struct {
 	enum ExprType type;
-	union ExprAs as;
-} Expr;
+	// source line it came from, fits in the padding before the union
+	uint32_t line;
+	union NodeAs as;
+} Node;
 
-struct Expr_Group {
-	Expr expr;
-};
-struct Expr_Op {
-	Expr lhs;
-	enum TokenType operator;
-	Expr rhs;
-};
+// a call node with its args looked up, made on the stack when something needs one
 struct Expr_Function_Call {
 	enum TokenType type;
 	Expr* argv;
@@ -50,6 +67,10 @@ typedef struct {
 	Token* argv;
 	size_t argc;
 	size_t arg_capacity;
+	// the body's tokens, exprs stays empty until parse_function is called on it
+	Token* body;
+	size_t body_size;
+	int parsed;
 } Function;
 
 typedef struct {
@@ -59,10 +80,36 @@ typedef struct {
 	Function* functions;
 	size_t function_count;
 	size_t function_capacity;
+	// sized from the token count up front (a token makes at most two nodes, and the optimizer
+	// adds at most one temp for each operator) so they never move, function bodies parsed
+	// later add onto the end
+	Node* nodes;
+	size_t node_count;
+	size_t node_capacity;
+	Expr* args;
+	size_t arg_count;
+	size_t arg_capacity;
+	// names of the optimizer's temps, each one is its own malloc so jit code can point at them
+	Token** temps;
+	size_t temp_count;
+	size_t temp_capacity;
 	int exit_code;
 } Parser;
 
+#define NODE(parser, expr) (&(parser)->nodes[(expr)])
+
+// returns 0 (and sets exit_code) when the nodes are full
+Expr add_node(Parser* res, Node node);
 Parser parse(Lexer lexer);
+// parses the body the first time it is needed, returns non zero if the body has errors
+int parse_function(Parser* parser, Function* function);
+// index of the function with that name, -1 if there isn't one
+int find_function(Parser parser, Token* name);
+struct Expr_Function_Call call_of(Parser* parser, Expr expr);
+// drops every function the top level can never end up calling, report prints what went
+void prune_functions(Parser* parser, int report);
+void print_expression(Parser* parser, int indents, Expr expr);
+void print_statements(Parser* parser, Expr* exprs, size_t size);
 void print_parser(Parser parser);
 void free_parser(Parser* parser);
 
@@ -0,0 +1,187 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pool.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+// the part of the range a thread still has to do, others take from end and it takes from next
+typedef struct {
+	pthread_mutex_t lock;
+	size_t next;
+	size_t end;
+} Pool_Range;
+
+typedef struct Pool Pool;
+
+typedef struct {
+	Pool* pool;
+	size_t worker;
+} Pool_Thread;
+
+struct Pool {
+	Pool_Range* ranges;
+	size_t workers;
+	Pool_Work work;
+	void* context;
+	// held for a whole pool_run, so runs on different threads wait for each other
+	pthread_mutex_t run_lock;
+	// bumped by every pool_run, the threads sleep on start until it changes
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	size_t round;
+	// threads still on this round, pool_run waits on finished until it gets to 0
+	pthread_cond_t finished;
+	size_t busy;
+	// threads that actually started, one that didn't just leaves its slice to be stolen
+	size_t running;
+	Pool_Thread* threads;
+	pthread_t* ids;
+};
+
+Pool* shared_pool = NULL;
+pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+int take_index(Pool_Range* range, size_t* index){
+	int found = 0;
+	pthread_mutex_lock(&range->lock);
+	if(range->next < range->end){
+		*index = range->next;
+		range->next++;
+		found = 1;
+	}
+	pthread_mutex_unlock(&range->lock);
+	return found;
+}
+
+// moves the back half of some other thread's range over to this one, 0 once nobody has any left
+int steal_range(Pool* pool, size_t thief){
+	for(size_t i = 1; i < pool->workers; i++){
+		Pool_Range* victim = &pool->ranges[(thief+i)%pool->workers];
+		pthread_mutex_lock(&victim->lock);
+		size_t left = victim->end-victim->next;
+		if(left == 0){
+			pthread_mutex_unlock(&victim->lock);
+			continue;
+		}
+		size_t end = victim->end;
+		size_t start = victim->next+left/2;
+		victim->end = start;
+		pthread_mutex_unlock(&victim->lock);
+
+		Pool_Range* own = &pool->ranges[thief];
+		pthread_mutex_lock(&own->lock);
+		own->next = start;
+		own->end = end;
+		pthread_mutex_unlock(&own->lock);
+		return 1;
+	}
+	return 0;
+}
+
+// does indexes until nobody has any left
+void work_ranges(Pool* pool, size_t worker){
+	size_t index = 0;
+	do{
+		while(take_index(&pool->ranges[worker], &index)){
+			pool->work(pool->context, index, worker);
+		}
+	}while(steal_range(pool, worker));
+}
+
+void* pool_thread(void* arg){
+	Pool_Thread* thread = arg;
+	Pool* pool = thread->pool;
+	size_t round = 0;
+	pthread_mutex_lock(&pool->lock);
+	while(1){
+		while(pool->round == round){
+			pthread_cond_wait(&pool->start, &pool->lock);
+		}
+		round = pool->round;
+		pthread_mutex_unlock(&pool->lock);
+		work_ranges(pool, thread->worker);
+		pthread_mutex_lock(&pool->lock);
+		pool->busy--;
+		if(pool->busy == 0){
+			pthread_cond_signal(&pool->finished);
+		}
+	}
+	return NULL;
+}
+
+// not from a Memory since it outlives every run, if it can't be made pool_run does the work itself
+void start_pool(void){
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t workers = cores > 0 ? (size_t)cores : 1;
+	Pool* made = calloc(1, sizeof(Pool));
+	if(made == NULL){
+		return;
+	}
+	made->workers = workers;
+	made->ranges = calloc(workers, sizeof(Pool_Range));
+	made->threads = calloc(workers, sizeof(Pool_Thread));
+	made->ids = calloc(workers, sizeof(pthread_t));
+	if(made->ranges == NULL || made->threads == NULL || made->ids == NULL){
+		free(made->ranges);
+		free(made->threads);
+		free(made->ids);
+		free(made);
+		return;
+	}
+	pthread_mutex_init(&made->run_lock, NULL);
+	pthread_mutex_init(&made->lock, NULL);
+	pthread_cond_init(&made->start, NULL);
+	pthread_cond_init(&made->finished, NULL);
+	for(size_t i = 0; i < workers; i++){
+		pthread_mutex_init(&made->ranges[i].lock, NULL);
+		made->threads[i].pool = made;
+		made->threads[i].worker = i;
+	}
+	for(size_t i = 1; i < workers; i++){
+		if(pthread_create(&made->ids[i], NULL, pool_thread, &made->threads[i]) == 0){
+			made->running++;
+		}
+	}
+	shared_pool = made;
+}
+
+Pool* get_pool(void){
+	pthread_once(&pool_once, start_pool);
+	return shared_pool;
+}
+
+size_t pool_workers(void){
+	Pool* pool = get_pool();
+	return pool != NULL ? pool->workers : 1;
+}
+
+void pool_run(size_t count, Pool_Work work, void* context){
+	Pool* pool = get_pool();
+	if(pool == NULL){
+		for(size_t i = 0; i < count; i++){
+			work(context, i, 0);
+		}
+		return;
+	}
+	pthread_mutex_lock(&pool->run_lock);
+	// every thread is asleep between rounds, so nothing else touches the ranges here
+	for(size_t i = 0; i < pool->workers; i++){
+		pool->ranges[i].next = count*i/pool->workers;
+		pool->ranges[i].end = count*(i+1)/pool->workers;
+	}
+	pthread_mutex_lock(&pool->lock);
+	pool->work = work;
+	pool->context = context;
+	pool->busy = pool->running;
+	pool->round++;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+
+	work_ranges(pool, 0);
+	pthread_mutex_lock(&pool->lock);
+	while(pool->busy > 0){
+		pthread_cond_wait(&pool->finished, &pool->lock);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	pthread_mutex_unlock(&pool->run_lock);
+}
@@ -0,0 +1,17 @@
+#ifndef POOL_H
+#define POOL_H
+#include <stddef.h>
+
+// called once for every index, worker says which thread it is on (0 up to pool_workers())
+typedef void (*Pool_Work)(void* context, size_t index, size_t worker);
+
+// how many threads pool_run spreads work over, one per core with the calling thread counted
+size_t pool_workers(void);
+// runs work for every index below count and returns once they have all finished
+// each thread starts on its own slice of the range and steals the back half of another
+// thread's slice when it runs out, the calling thread is worker 0
+// the threads are started by the first call and wait for the next one after that, they are
+// shared by the whole process so calls from different threads take turns
+void pool_run(size_t count, Pool_Work work, void* context);
+
+#endif // POOL_H
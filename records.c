@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include "records.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+Record_Reader new_record_reader(int fd){
+	Record_Reader reader = {
+		.fd = fd,
+		.capacity = RECORD_BUFFER_SIZE,
+		.buffer = mem_alloc(RECORD_BUFFER_SIZE),
+		.start = 0,
+		.end = 0,
+		.eof = 0,
+		.number = 0,
+		.line = NULL,
+		.line_size = 0,
+		.field_count = 0,
+		.field_capacity = 16,
+	};
+	reader.fields = mem_alloc(reader.field_capacity*sizeof(char*));
+	reader.field_sizes = mem_alloc(reader.field_capacity*sizeof(size_t));
+	return reader;
+}
+
+char* find_newline(char* from, char* to){
+#ifdef __SSE2__
+	__m128i newline = _mm_set1_epi8('\n');
+	while(to-from >= 16){
+		__m128i chunk = _mm_loadu_si128((__m128i*)from);
+		int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+		if(mask != 0){
+			return from + __builtin_ctz(mask);
+		}
+		from += 16;
+	}
+#endif
+	return memchr(from, '\n', to-from);
+}
+
+// bit i is set when line[offset+i] is a space or tab, anything past the end counts as one
+unsigned int separator_mask(char* line, size_t size, size_t offset){
+	unsigned int mask = 0;
+#ifdef __SSE2__
+	if(size-offset >= 16){
+		__m128i chunk = _mm_loadu_si128((__m128i*)(line+offset));
+		__m128i spaces = _mm_cmpeq_epi8(chunk, _mm_set1_epi8(' '));
+		__m128i tabs = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'));
+		return (unsigned int)_mm_movemask_epi8(_mm_or_si128(spaces, tabs));
+	}
+#endif
+	for(size_t i = 0; i < 16; i++){
+		if(offset+i >= size || line[offset+i] == ' ' || line[offset+i] == '\t'){
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+}
+
+void add_field(Record_Reader* reader, char* start, size_t size){
+	if(reader->field_count >= reader->field_capacity){
+		reader->field_capacity *= 2;
+		reader->fields = mem_realloc(reader->fields, reader->field_capacity*sizeof(char*));
+		reader->field_sizes = mem_realloc(reader->field_sizes, reader->field_capacity*sizeof(size_t));
+	}
+	reader->fields[reader->field_count] = start;
+	reader->field_sizes[reader->field_count] = size;
+	reader->field_count++;
+}
+
+// walks 16 bytes at a time, jumping straight to the next edge between a field and a separator
+void split_fields(Record_Reader* reader){
+	reader->field_count = 0;
+	char* line = reader->line;
+	size_t size = reader->line_size;
+	int in_field = 0;
+	size_t field_start = 0;
+	for(size_t offset = 0; offset < size; offset += 16){
+		unsigned int separators = separator_mask(line, size, offset);
+		unsigned int characters = ~separators & 0xffff;
+		unsigned int position = 0;
+		while(position < 16){
+			unsigned int edges = (in_field ? separators : characters) >> position;
+			if(edges == 0){
+				break;
+			}
+			position += __builtin_ctz(edges);
+			if(in_field){
+				add_field(reader, line+field_start, offset+position-field_start);
+			}
+			else{
+				field_start = offset+position;
+			}
+			in_field = !in_field;
+		}
+	}
+	if(in_field){
+		add_field(reader, line+field_start, size-field_start);
+	}
+}
+
+// returns 0 if nothing more could be read
+int fill_buffer(Record_Reader* reader){
+	if(reader->start > 0){
+		memmove(reader->buffer, reader->buffer+reader->start, reader->end-reader->start);
+		reader->end -= reader->start;
+		reader->start = 0;
+	}
+	// always keep a spare byte to terminate a last line that has no newline
+	if(reader->end+1 >= reader->capacity){
+		reader->capacity *= 2;
+		reader->buffer = mem_realloc(reader->buffer, reader->capacity);
+	}
+	while(1){
+		ssize_t got = read(reader->fd, reader->buffer+reader->end, reader->capacity-reader->end-1);
+		if(got < 0 && errno == EINTR){
+			continue;
+		}
+		if(got < 0){
+			fprintf(stderr, "[ERR] Failed to read input: %s\n", strerror(errno));
+		}
+		if(got <= 0){
+			reader->eof = 1;
+			return 0;
+		}
+		reader->end += got;
+		return 1;
+	}
+}
+
+int next_record(Record_Reader* reader){
+	size_t searched = reader->start;
+	while(1){
+		char* newline = find_newline(reader->buffer+searched, reader->buffer+reader->end);
+		size_t line_end = 0;
+		if(newline != NULL){
+			line_end = newline-reader->buffer;
+		}
+		else if(!reader->eof){
+			searched = reader->end-reader->start;
+			fill_buffer(reader);
+			continue;
+		}
+		else if(reader->start < reader->end){
+			line_end = reader->end;
+			reader->end++;
+		}
+		else{
+			return 0;
+		}
+
+		reader->line = reader->buffer+reader->start;
+		reader->line_size = line_end-reader->start;
+		reader->buffer[line_end] = '\0';
+		if(reader->line_size > 0 && reader->line[reader->line_size-1] == '\r'){
+			reader->line_size--;
+			reader->line[reader->line_size] = '\0';
+		}
+		reader->start = line_end+1;
+		reader->number++;
+		split_fields(reader);
+		return 1;
+	}
+}
+
+void free_record_reader(Record_Reader* reader){
+	mem_free(reader->buffer);
+	mem_free(reader->fields);
+	mem_free(reader->field_sizes);
+	reader->buffer = NULL;
+}
@@ -0,0 +1,34 @@
+#ifndef RECORDS_H
+#define RECORDS_H
+#include <stddef.h>
+
+#define RECORD_BUFFER_SIZE (1 << 20)
+
+// reads input a big block at a time and hands out one line (record) at a time, the line
+// and its fields point straight into the buffer and stay valid until the next record
+typedef struct {
+	int fd;
+	char* buffer;
+	size_t capacity;
+	size_t start;
+	size_t end;
+	int eof;
+	size_t number;
+
+	char* line;
+	size_t line_size;
+	// fields are split on runs of spaces and tabs like awk does
+	char** fields;
+	size_t* field_sizes;
+	size_t field_count;
+	size_t field_capacity;
+} Record_Reader;
+
+Record_Reader new_record_reader(int fd);
+// NULL if there is no newline between from and to
+char* find_newline(char* from, char* to);
+// returns 0 once the input has run out
+int next_record(Record_Reader* reader);
+void free_record_reader(Record_Reader* reader);
+
+#endif // RECORDS_H
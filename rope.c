@@ -0,0 +1,64 @@
+#include "rope.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+Rope* new_rope(void){
+	Rope* rope = mem_alloc(sizeof(Rope));
+	rope->piece_count = 0;
+	rope->piece_capacity = 8;
+	rope->pieces = mem_alloc(rope->piece_capacity*sizeof(char*));
+	rope->piece_sizes = mem_alloc(rope->piece_capacity*sizeof(size_t));
+	rope->size = 0;
+	return rope;
+}
+
+void rope_adopt(Rope* rope, char* str, size_t size){
+	if(rope->piece_count >= rope->piece_capacity){
+		rope->piece_capacity *= 2;
+		rope->pieces = mem_realloc(rope->pieces, rope->piece_capacity*sizeof(char*));
+		rope->piece_sizes = mem_realloc(rope->piece_sizes, rope->piece_capacity*sizeof(size_t));
+	}
+	rope->pieces[rope->piece_count] = str;
+	rope->piece_sizes[rope->piece_count] = size;
+	rope->piece_count++;
+	rope->size += size;
+}
+
+void rope_append(Rope* rope, char* str, size_t size){
+	if(size == 0){
+		return;
+	}
+	char* piece = mem_alloc(sizeof(char)*size);
+	memcpy(piece, str, size);
+	rope_adopt(rope, piece, size);
+}
+
+void rope_write(Rope* rope, FILE* file){
+	for(size_t i = 0; i < rope->piece_count; i++){
+		fwrite(rope->pieces[i], sizeof(char), rope->piece_sizes[i], file);
+	}
+}
+
+char* rope_flatten(Rope* rope, size_t* size){
+	char* str = mem_alloc(sizeof(char)*(rope->size+1));
+	size_t offset = 0;
+	for(size_t i = 0; i < rope->piece_count; i++){
+		memcpy(str+offset, rope->pieces[i], rope->piece_sizes[i]);
+		offset += rope->piece_sizes[i];
+	}
+	str[offset] = '\0';
+	*size = offset;
+	free_rope(rope);
+	return str;
+}
+
+void free_rope(Rope* rope){
+	for(size_t i = 0; i < rope->piece_count; i++){
+		mem_free(rope->pieces[i]);
+	}
+	mem_free(rope->pieces);
+	mem_free(rope->piece_sizes);
+	mem_free(rope);
+}
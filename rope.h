@@ -0,0 +1,25 @@
+#ifndef ROPE_H
+#define ROPE_H
+#include <stddef.h>
+#include <stdio.h>
+
+// a string under construction, appends just add a piece to the list and the
+// pieces only get joined together when something needs the whole string
+typedef struct {
+	char** pieces;
+	size_t* piece_sizes;
+	size_t piece_count;
+	size_t piece_capacity;
+	size_t size;
+} Rope;
+
+Rope* new_rope(void);
+// takes ownership of str, which must have come from mem_alloc
+void rope_adopt(Rope* rope, char* str, size_t size);
+void rope_append(Rope* rope, char* str, size_t size);
+void rope_write(Rope* rope, FILE* file);
+// joins the pieces into one null terminated string and frees the rope
+char* rope_flatten(Rope* rope, size_t* size);
+void free_rope(Rope* rope);
+
+#endif // ROPE_H
@@ -0,0 +1,151 @@
+#define _POSIX_C_SOURCE 200809L
+#include "shell.h"
+#include "memory.h"
+#include <spawn.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern char** environ;
+
+int shell_start(char* command, int capture, Shell_Job* job){
+	job->fd = -1;
+	job->out = NULL;
+	job->out_size = 0;
+	job->out_capacity = 0;
+	job->status = 0;
+
+	// before anything is opened or spawned, in case it gets refused
+	if(capture){
+		job->out_capacity = 256;
+		job->out = mem_alloc(job->out_capacity);
+	}
+
+	int fds[2] = {-1, -1};
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if(capture){
+		if(pipe(fds) != 0){
+			fprintf(stderr, "[ERR] Failed to make a pipe for `%s`\n", command);
+			posix_spawn_file_actions_destroy(&actions);
+			mem_free(job->out);
+			job->out = NULL;
+			return 1;
+		}
+		// so the other jobs running at the same time don't hold this pipe open
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+		posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+	}
+
+	// anything we printed has to come out before the child's output
+	fflush(stdout);
+	char* argv[] = {"sh", "-c", command, NULL};
+	int res = posix_spawn(&job->pid, "/bin/sh", &actions, NULL, argv, environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if(capture){
+		close(fds[1]);
+	}
+	if(res != 0){
+		fprintf(stderr, "[ERR] Failed to run `%s`: %s\n", command, strerror(res));
+		if(capture){
+			close(fds[0]);
+			mem_free(job->out);
+			job->out = NULL;
+		}
+		return 1;
+	}
+
+	if(capture){
+		job->fd = fds[0];
+	}
+	return 0;
+}
+
+// returns 1 once the pipe hit the end
+int read_job(Shell_Job* job){
+	if(job->out_size+4096 > job->out_capacity){
+		// the job stays as it was if the resize gets refused
+		size_t capacity = job->out_capacity;
+		while(job->out_size+4096 > capacity){
+			capacity *= 2;
+		}
+		job->out = mem_realloc(job->out, capacity);
+		job->out_capacity = capacity;
+	}
+	ssize_t got = read(job->fd, job->out+job->out_size, job->out_capacity-job->out_size-1);
+	if(got < 0 && errno == EINTR){
+		return 0;
+	}
+	if(got <= 0){
+		return 1;
+	}
+	job->out_size += got;
+	return 0;
+}
+
+void shell_wait_all(Shell_Job* jobs, size_t count){
+	if(count == 0){
+		return;
+	}
+	struct pollfd* fds = mem_alloc(sizeof(struct pollfd)*(count+1));
+	size_t* owners = mem_alloc(sizeof(size_t)*(count+1));
+	while(1){
+		size_t open = 0;
+		for(size_t i = 0; i < count; i++){
+			if(jobs[i].fd < 0){
+				continue;
+			}
+			fds[open].fd = jobs[i].fd;
+			fds[open].events = POLLIN;
+			fds[open].revents = 0;
+			owners[open] = i;
+			open++;
+		}
+		if(open == 0){
+			break;
+		}
+		if(poll(fds, open, -1) < 0){
+			if(errno == EINTR){
+				continue;
+			}
+			fprintf(stderr, "[ERR] Failed waiting on command output\n");
+			break;
+		}
+		for(size_t i = 0; i < open; i++){
+			if(fds[i].revents == 0){
+				continue;
+			}
+			Shell_Job* job = &jobs[owners[i]];
+			if(read_job(job)){
+				close(job->fd);
+				job->fd = -1;
+			}
+		}
+	}
+	mem_free(fds);
+	mem_free(owners);
+
+	for(size_t i = 0; i < count; i++){
+		if(jobs[i].fd >= 0){
+			close(jobs[i].fd);
+			jobs[i].fd = -1;
+		}
+		int status = 0;
+		while(waitpid(jobs[i].pid, &status, 0) < 0 && errno == EINTR){}
+		jobs[i].status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+		if(jobs[i].out == NULL){
+			continue;
+		}
+		// like $(...) in a shell, the trailing newlines are dropped
+		while(jobs[i].out_size > 0 && jobs[i].out[jobs[i].out_size-1] == '\n'){
+			jobs[i].out_size--;
+		}
+		jobs[i].out[jobs[i].out_size] = '\0';
+	}
+}
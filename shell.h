@@ -0,0 +1,24 @@
+#ifndef SHELL_H
+#define SHELL_H
+#include <stddef.h>
+#include <sys/types.h>
+#include "lexer.h"
+
+typedef struct {
+	pid_t pid;
+	// read end of the child's stdout, -1 when it isn't being captured
+	int fd;
+	char* out;
+	size_t out_size;
+	size_t out_capacity;
+	int status;
+	// var the output goes into once it is waited on
+	Token* name;
+} Shell_Job;
+
+// starts `/bin/sh -c command` with posix_spawn, capture pipes its stdout back to us
+int shell_start(char* command, int capture, Shell_Job* job);
+// reads every captured pipe as output shows up and reaps all the jobs
+void shell_wait_all(Shell_Job* jobs, size_t count);
+
+#endif // SHELL_H
@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+#include "snapshot.h"
+#include "memory.h"
+#include "files.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+size_t snapshot_padding(size_t size){
+	return (8-size%8)%8;
+}
+
+// the string, its null and then zeros up to the next 8 bytes
+void write_padded(FILE* file, const char* str, size_t size){
+	static const char zeros[8] = {0};
+	fwrite(str, 1, size, file);
+	fwrite(zeros, 1, 1+snapshot_padding(size+1), file);
+}
+
+int save_snapshot(char* path, uint64_t source_hash, size_t pc, Var* vars, size_t var_count, Memo_Entry* memo){
+	size_t path_size = strlen(path);
+	char* temp = mem_alloc(path_size+5);
+	memcpy(temp, path, path_size);
+	memcpy(temp+path_size, ".tmp", 5);
+	FILE* file = fopen(temp, "wb");
+	if(file == NULL){
+		fprintf(stderr, "[ERR] Failed to open %s: %s\n", temp, strerror(errno));
+		mem_free(temp);
+		return 1;
+	}
+
+	Snapshot_Header header = {0};
+	memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+	header.source_hash = source_hash;
+	header.pc = pc;
+	header.var_count = var_count;
+	header.token_types = NEWLINE;
+	for(size_t i = 0; memo != NULL && i < MEMO_SLOTS; i++){
+		if(memo[i].key != NULL){
+			header.memo_count++;
+		}
+	}
+	fwrite(&header, sizeof(header), 1, file);
+
+	for(size_t i = 0; i < var_count; i++){
+		Snapshot_Var record = {
+			.type = vars[i].type,
+			.name_size = vars[i].name_size,
+			.str_size = vars[i].str_size,
+		};
+		fwrite(&record, sizeof(record), 1, file);
+		write_padded(file, vars[i].name, vars[i].name_size);
+		write_padded(file, vars[i].str, vars[i].str_size);
+	}
+	for(size_t i = 0; memo != NULL && i < MEMO_SLOTS; i++){
+		if(memo[i].key == NULL){
+			continue;
+		}
+		Snapshot_Memo record = {
+			.slot = i,
+			.function = memo[i].function,
+			.type = memo[i].value.type,
+			.key_size = memo[i].key_size,
+			.value_size = memo[i].value.str_size,
+		};
+		fwrite(&record, sizeof(record), 1, file);
+		write_padded(file, memo[i].key, memo[i].key_size);
+		write_padded(file, memo[i].value.str, memo[i].value.str_size);
+	}
+
+	int failed = ferror(file);
+	if(fclose(file) != 0 || failed){
+		fprintf(stderr, "[ERR] Failed to write %s\n", temp);
+		goto fail;
+	}
+	if(rename(temp, path) != 0){
+		fprintf(stderr, "[ERR] Failed to move %s to %s: %s\n", temp, path, strerror(errno));
+		goto fail;
+	}
+	mem_free(temp);
+	return 0;
+
+fail:
+	remove(temp);
+	mem_free(temp);
+	return 1;
+}
+
+int open_snapshot(char* path, uint64_t source_hash, size_t pc, Snapshot* snapshot){
+	snapshot->data = NULL;
+	snapshot->size = 0;
+	// the first run has nothing to restore, that isn't worth an error
+	if(access(path, R_OK) != 0){
+		return 1;
+	}
+	if(map_file(path, &snapshot->data, &snapshot->size) != 0){
+		return 1;
+	}
+	Snapshot_Header* header = (Snapshot_Header*)snapshot->data;
+	if(snapshot->size < sizeof(Snapshot_Header)
+	|| memcmp(header->magic, SNAPSHOT_MAGIC, 8) != 0
+	|| header->token_types != NEWLINE
+	|| header->source_hash != source_hash
+	|| header->pc != pc){
+		close_snapshot(snapshot);
+		return 1;
+	}
+	return 0;
+}
+
+// moves offset past a string written by write_padded, 0 if it runs off the end of the map
+int skip_padded(Snapshot* snapshot, size_t* offset, uint64_t size){
+	if(size >= snapshot->size){
+		return 0;
+	}
+	size_t padded = size+1+snapshot_padding(size+1);
+	if(padded > snapshot->size-*offset){
+		return 0;
+	}
+	*offset += padded;
+	return 1;
+}
+
+// walks every record first so a damaged file is turned down before anything gets built
+int check_snapshot(Snapshot* snapshot){
+	Snapshot_Header* header = (Snapshot_Header*)snapshot->data;
+	size_t offset = sizeof(Snapshot_Header);
+	for(uint64_t i = 0; i < header->var_count; i++){
+		if(snapshot->size-offset < sizeof(Snapshot_Var)){
+			return 0;
+		}
+		Snapshot_Var* record = (Snapshot_Var*)(snapshot->data+offset);
+		offset += sizeof(Snapshot_Var);
+		if(record->type != INTEGER && record->type != STRING){
+			return 0;
+		}
+		if(!skip_padded(snapshot, &offset, record->name_size) || !skip_padded(snapshot, &offset, record->str_size)){
+			return 0;
+		}
+	}
+	for(uint64_t i = 0; i < header->memo_count; i++){
+		if(snapshot->size-offset < sizeof(Snapshot_Memo)){
+			return 0;
+		}
+		Snapshot_Memo* record = (Snapshot_Memo*)(snapshot->data+offset);
+		offset += sizeof(Snapshot_Memo);
+		if(record->slot >= MEMO_SLOTS || (record->type != INTEGER && record->type != STRING)){
+			return 0;
+		}
+		if(!skip_padded(snapshot, &offset, record->key_size) || !skip_padded(snapshot, &offset, record->value_size)){
+			return 0;
+		}
+	}
+	return offset == snapshot->size;
+}
+
+int restore_snapshot(Snapshot* snapshot, Var** vars, size_t* var_count, size_t* var_cap, Memo_Entry** memo){
+	if(!check_snapshot(snapshot)){
+		return 1;
+	}
+	Snapshot_Header* header = (Snapshot_Header*)snapshot->data;
+	size_t offset = sizeof(Snapshot_Header);
+	for(uint64_t i = 0; i < header->var_count; i++){
+		Snapshot_Var* record = (Snapshot_Var*)(snapshot->data+offset);
+		offset += sizeof(Snapshot_Var);
+		Var var = {0};
+		var.type = record->type;
+		var.name_size = record->name_size;
+		var.name = mem_alloc(sizeof(char)*(var.name_size+1));
+		memcpy(var.name, snapshot->data+offset, var.name_size+1);
+		skip_padded(snapshot, &offset, record->name_size);
+		// the values stay in the map until something writes over them
+		var.str = snapshot->data+offset;
+		var.str_size = record->str_size;
+		var.borrowed = 1;
+		skip_padded(snapshot, &offset, record->str_size);
+		add_var(vars, var_count, var_cap, var);
+	}
+	if(header->memo_count > 0 && *memo == NULL){
+		*memo = mem_calloc(MEMO_SLOTS, sizeof(Memo_Entry));
+	}
+	for(uint64_t i = 0; i < header->memo_count; i++){
+		Snapshot_Memo* record = (Snapshot_Memo*)(snapshot->data+offset);
+		offset += sizeof(Snapshot_Memo);
+		Memo_Entry* entry = &(*memo)[record->slot];
+		mem_free(entry->key);
+		mem_free(entry->value.str);
+		entry->function = record->function;
+		entry->key_size = record->key_size;
+		entry->key = mem_alloc(entry->key_size+1);
+		memcpy(entry->key, snapshot->data+offset, entry->key_size+1);
+		skip_padded(snapshot, &offset, record->key_size);
+		// memo values get freed when their slot is replaced, so they can't point into the map
+		entry->value.type = record->type;
+		entry->value.str_size = record->value_size;
+		entry->value.str = mem_alloc(sizeof(char)*(entry->value.str_size+1));
+		memcpy(entry->value.str, snapshot->data+offset, entry->value.str_size+1);
+		skip_padded(snapshot, &offset, record->value_size);
+	}
+	return 0;
+}
+
+void close_snapshot(Snapshot* snapshot){
+	unmap_file(snapshot->data, snapshot->size);
+	snapshot->data = NULL;
+	snapshot->size = 0;
+}
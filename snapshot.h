@@ -0,0 +1,55 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+#include <stddef.h>
+#include <stdint.h>
+#include "interpreter.h"
+
+// a snapshot file is a header, the top level vars and then the memo table, every record is
+// padded to 8 bytes and every string has a null after it so it can be used straight from the map
+#define SNAPSHOT_MAGIC "pstsnap1"
+
+typedef struct {
+	char magic[8];
+	// of the program's source, a snapshot only ever gets used by the program that saved it
+	uint64_t source_hash;
+	// the top level statement to carry on from
+	uint64_t pc;
+	uint64_t var_count;
+	uint64_t memo_count;
+	// NEWLINE's value, so a build with different token numbers doesn't misread the types
+	uint32_t token_types;
+	uint32_t unused;
+} Snapshot_Header;
+
+typedef struct {
+	uint32_t type;
+	uint32_t name_size;
+	uint64_t str_size;
+} Snapshot_Var;
+
+typedef struct {
+	uint32_t slot;
+	int32_t function;
+	uint32_t type;
+	uint32_t unused;
+	uint64_t key_size;
+	uint64_t value_size;
+} Snapshot_Memo;
+
+typedef struct {
+	char* data;
+	size_t size;
+} Snapshot;
+
+// vars can't be ropes, they get flattened before this, it writes to a temp file and renames
+// it over path so a half written snapshot is never picked up, memo is NULL if nothing was cached
+int save_snapshot(char* path, uint64_t source_hash, size_t pc, Var* vars, size_t var_count, Memo_Entry* memo);
+// maps path if it is a snapshot this same source saved at pc, non zero if there isn't one
+int open_snapshot(char* path, uint64_t source_hash, size_t pc, Snapshot* snapshot);
+// adds the saved vars onto vars, their strings are borrowed from the map so it has to stay open
+// while they're around, non zero (with nothing added) if the file is damaged
+// the memo table is made if the snapshot has entries for it and it hasn't been yet
+int restore_snapshot(Snapshot* snapshot, Var** vars, size_t* var_count, size_t* var_cap, Memo_Entry** memo);
+void close_snapshot(Snapshot* snapshot);
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,113 @@
+#include "std.h"
+#include "memory.h"
+#include <stdlib.h>
+#include <string.h>
+
+int compare_std_name(const char* lhs, size_t lhs_size, const char* rhs, size_t rhs_size){
+	int order = memcmp(lhs, rhs, lhs_size < rhs_size ? lhs_size : rhs_size);
+	if(order != 0){
+		return order;
+	}
+	return (lhs_size > rhs_size) - (lhs_size < rhs_size);
+}
+
+int find_std_function(char* name, size_t name_size){
+	size_t low = 0;
+	size_t high = std_function_count;
+	while(low < high){
+		size_t mid = low+(high-low)/2;
+		const Std_Function* function = &std_functions[mid];
+		int order = compare_std_name(name, name_size, std_strings+function->name, function->name_size);
+		if(order == 0){
+			return (int)mid;
+		}
+		if(order < 0){
+			high = mid;
+		}
+		else{
+			low = mid+1;
+		}
+	}
+	return -1;
+}
+
+Token std_token(uint32_t index){
+	const Std_Token* token = &std_tokens[index];
+	return (Token){
+		.type = token->type,
+		// never written to or freed, it is read-only like the rest of the blob
+		.str = (char*)std_strings+token->str,
+		.size = token->size,
+		.line = token->line,
+	};
+}
+
+void add_std_function(Parser* parser, const Std_Function* std){
+	Function function = {
+		.name_size = std->name_size,
+		.name = mem_alloc(sizeof(char)*(std->name_size+1)),
+		.exprs = NULL,
+		.size = 0,
+		.capacity = 0,
+		// the args and the body share one block, so free_function freeing argv frees both
+		.argv = mem_alloc((std->argc+std->body_size)*sizeof(Token)),
+		.argc = std->argc,
+		.arg_capacity = std->argc,
+		.body_size = std->body_size,
+		.parsed = 0,
+	};
+	memcpy(function.name, std_strings+std->name, std->name_size);
+	function.name[function.name_size] = '\0';
+	for(uint32_t i = 0; i < std->argc; i++){
+		function.argv[i] = std_token(std->args+i);
+	}
+	function.body = function.argv+std->argc;
+	for(uint32_t i = 0; i < std->body_size; i++){
+		function.body[i] = std_token(std->body+i);
+	}
+
+	if(parser->function_count >= parser->function_capacity){
+		parser->function_capacity *= 2;
+		parser->functions = mem_realloc(parser->functions, parser->function_capacity*sizeof(Function));
+	}
+	parser->functions[parser->function_count] = function;
+	parser->function_count++;
+}
+
+// every `call name` in the tokens that nothing defines yet gets looked up in the stdlib
+size_t link_calls(Parser* parser, Token* tokens, size_t size){
+	size_t added_tokens = 0;
+	for(size_t i = 0; i+1 < size; i++){
+		if(tokens[i].type != CALL || tokens[i+1].type != IDENTIFIER){
+			continue;
+		}
+		if(find_function(*parser, &tokens[i+1]) >= 0){
+			continue;
+		}
+		int index = find_std_function(tokens[i+1].str, tokens[i+1].size);
+		if(index < 0){
+			continue;
+		}
+		add_std_function(parser, &std_functions[index]);
+		added_tokens += std_functions[index].body_size;
+	}
+	return added_tokens;
+}
+
+size_t link_std(Parser* parser, Lexer lexer){
+	size_t first = parser->function_count;
+	// the program's tokens cover the top level and the bodies of its own functions
+	size_t added_tokens = link_calls(parser, lexer.tokens, lexer.size);
+	// stdlib functions can call each other, this also goes over the ones added on the way
+	for(size_t i = first; i < parser->function_count; i++){
+		added_tokens += link_calls(parser, parser->functions[i].body, parser->functions[i].body_size);
+	}
+	if(added_tokens > 0){
+		// room for their nodes once they get parsed, nothing has pointed into these yet
+		parser->node_capacity += 3*added_tokens;
+		parser->nodes = mem_realloc(parser->nodes, parser->node_capacity*sizeof(Node));
+		parser->arg_capacity += 2*added_tokens;
+		parser->args = mem_realloc(parser->args, parser->arg_capacity*sizeof(Expr));
+	}
+	return parser->function_count-first;
+}
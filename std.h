@@ -0,0 +1,41 @@
+#ifndef STD_H
+#define STD_H
+#include <stddef.h>
+#include <stdint.h>
+#include "lexer.h"
+#include "parser.h"
+
+// the stdlib (std/*.pastry) is lexed and checked at build time by stdpack, which writes
+// it out as std_blob.c, everything in it is offsets so it sits in read-only data as is
+
+typedef struct {
+	uint32_t type;
+	uint32_t line;
+	// into std_strings, every token's text is null terminated there
+	uint32_t str;
+	uint32_t size;
+} Std_Token;
+
+typedef struct {
+	uint32_t name;
+	uint32_t name_size;
+	// indexes into std_tokens
+	uint32_t args;
+	uint32_t argc;
+	uint32_t body;
+	uint32_t body_size;
+} Std_Function;
+
+extern const char std_strings[];
+extern const Std_Token std_tokens[];
+// sorted by name so a lookup is a binary search
+extern const Std_Function std_functions[];
+extern const size_t std_function_count;
+
+// index into std_functions, -1 if the stdlib doesn't have it
+int find_std_function(char* name, size_t name_size);
+// adds every stdlib function the program can end up calling and isn't defining itself,
+// nothing else in the stdlib is ever touched, returns how many got added
+size_t link_std(Parser* parser, Lexer lexer);
+
+#endif // STD_H
@@ -0,0 +1,163 @@
+// generated by stdpack from the std/*.pastry sources, don't edit
+#include "std.h"
+
+const char std_strings[] = {
+	0x0a, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x00, 0x5f, 0x5f, 0x73, 0x74, 0x64, 0x73, 0x71, 0x75, 0x61,
+	0x72, 0x65, 0x00, 0x6e, 0x00, 0x0a, 0x00, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x00, 0x28, 0x00,
+	0x6e, 0x00, 0x2a, 0x00, 0x6e, 0x00, 0x29, 0x00, 0x0a, 0x00, 0x65, 0x6e, 0x64, 0x00, 0x0a, 0x00,
+	0x0a, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x00, 0x5f, 0x5f, 0x73, 0x74, 0x64, 0x63, 0x75, 0x62, 0x65,
+	0x00, 0x6e, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72, 0x00, 0x73, 0x00, 0x63, 0x61, 0x6c, 0x6c, 0x00,
+	0x5f, 0x5f, 0x73, 0x74, 0x64, 0x73, 0x71, 0x75, 0x61, 0x72, 0x65, 0x00, 0x6e, 0x00, 0x0a, 0x00,
+	0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x00, 0x28, 0x00, 0x73, 0x00, 0x2a, 0x00, 0x6e, 0x00, 0x29,
+	0x00, 0x0a, 0x00, 0x65, 0x6e, 0x64, 0x00, 0x0a, 0x00, 0x0a, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x00,
+	0x5f, 0x5f, 0x73, 0x74, 0x64, 0x70, 0x6f, 0x77, 0x00, 0x6e, 0x00, 0x65, 0x00, 0x0a, 0x00, 0x76,
+	0x61, 0x72, 0x00, 0x72, 0x00, 0x31, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72, 0x00, 0x69, 0x00, 0x30,
+	0x00, 0x0a, 0x00, 0x66, 0x6f, 0x72, 0x00, 0x69, 0x00, 0x65, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72,
+	0x00, 0x72, 0x00, 0x28, 0x00, 0x72, 0x00, 0x2a, 0x00, 0x6e, 0x00, 0x29, 0x00, 0x0a, 0x00, 0x65,
+	0x6e, 0x64, 0x00, 0x0a, 0x00, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x00, 0x72, 0x00, 0x0a, 0x00,
+	0x65, 0x6e, 0x64, 0x00, 0x0a, 0x00, 0x0a, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x00, 0x5f, 0x5f, 0x73,
+	0x74, 0x64, 0x73, 0x75, 0x6d, 0x00, 0x6e, 0x00, 0x0a, 0x00, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e,
+	0x00, 0x28, 0x00, 0x28, 0x00, 0x6e, 0x00, 0x2a, 0x00, 0x28, 0x00, 0x6e, 0x00, 0x2b, 0x00, 0x31,
+	0x00, 0x29, 0x00, 0x29, 0x00, 0x2f, 0x00, 0x32, 0x00, 0x29, 0x00, 0x0a, 0x00, 0x65, 0x6e, 0x64,
+	0x00, 0x0a, 0x00, 0x0a, 0x00, 0x66, 0x75, 0x6e, 0x63, 0x00, 0x5f, 0x5f, 0x73, 0x74, 0x64, 0x72,
+	0x65, 0x70, 0x65, 0x61, 0x74, 0x00, 0x73, 0x00, 0x6e, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72, 0x00,
+	0x6f, 0x75, 0x74, 0x00, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72, 0x00, 0x69, 0x00, 0x30, 0x00, 0x0a,
+	0x00, 0x66, 0x6f, 0x72, 0x00, 0x69, 0x00, 0x6e, 0x00, 0x0a, 0x00, 0x76, 0x61, 0x72, 0x00, 0x6f,
+	0x75, 0x74, 0x00, 0x6f, 0x75, 0x74, 0x00, 0x2b, 0x00, 0x73, 0x00, 0x0a, 0x00, 0x65, 0x6e, 0x64,
+	0x00, 0x0a, 0x00, 0x72, 0x65, 0x74, 0x75, 0x72, 0x6e, 0x00, 0x6f, 0x75, 0x74, 0x00, 0x0a, 0x00,
+	0x65, 0x6e, 0x64, 0x00, 0x0a, 0x00,
+	0x00,
+};
+
+const Std_Token std_tokens[] = {
+	{44, 2, 0, 1},
+	{28, 3, 2, 4},
+	{12, 3, 7, 11},
+	{12, 3, 19, 1},
+	{44, 3, 21, 1},
+	{30, 4, 23, 6},
+	{0, 4, 30, 1},
+	{12, 4, 32, 1},
+	{9, 4, 34, 1},
+	{12, 4, 36, 1},
+	{1, 4, 38, 1},
+	{44, 4, 40, 1},
+	{27, 5, 42, 3},
+	{44, 5, 46, 1},
+	{44, 6, 48, 1},
+	{28, 7, 50, 4},
+	{12, 7, 55, 9},
+	{12, 7, 65, 1},
+	{44, 7, 67, 1},
+	{15, 8, 69, 3},
+	{12, 8, 73, 1},
+	{29, 8, 75, 4},
+	{12, 8, 80, 11},
+	{12, 8, 92, 1},
+	{44, 8, 94, 1},
+	{30, 9, 96, 6},
+	{0, 9, 103, 1},
+	{12, 9, 105, 1},
+	{9, 9, 107, 1},
+	{12, 9, 109, 1},
+	{1, 9, 111, 1},
+	{44, 9, 113, 1},
+	{27, 10, 115, 3},
+	{44, 10, 119, 1},
+	{44, 11, 121, 1},
+	{28, 13, 123, 4},
+	{12, 13, 128, 8},
+	{12, 13, 137, 1},
+	{12, 13, 139, 1},
+	{44, 13, 141, 1},
+	{15, 14, 143, 3},
+	{12, 14, 147, 1},
+	{13, 14, 149, 1},
+	{44, 14, 151, 1},
+	{15, 15, 153, 3},
+	{12, 15, 157, 1},
+	{13, 15, 159, 1},
+	{44, 15, 161, 1},
+	{18, 16, 163, 3},
+	{12, 16, 167, 1},
+	{12, 16, 169, 1},
+	{44, 16, 171, 1},
+	{15, 17, 173, 3},
+	{12, 17, 177, 1},
+	{0, 17, 179, 1},
+	{12, 17, 181, 1},
+	{9, 17, 183, 1},
+	{12, 17, 185, 1},
+	{1, 17, 187, 1},
+	{44, 17, 189, 1},
+	{27, 18, 191, 3},
+	{44, 18, 195, 1},
+	{30, 19, 197, 6},
+	{12, 19, 204, 1},
+	{44, 19, 206, 1},
+	{27, 20, 208, 3},
+	{44, 20, 212, 1},
+	{44, 21, 214, 1},
+	{28, 23, 216, 4},
+	{12, 23, 221, 8},
+	{12, 23, 230, 1},
+	{44, 23, 232, 1},
+	{30, 24, 234, 6},
+	{0, 24, 241, 1},
+	{0, 24, 243, 1},
+	{12, 24, 245, 1},
+	{9, 24, 247, 1},
+	{0, 24, 249, 1},
+	{12, 24, 251, 1},
+	{7, 24, 253, 1},
+	{13, 24, 255, 1},
+	{1, 24, 257, 1},
+	{1, 24, 259, 1},
+	{10, 24, 261, 1},
+	{13, 24, 263, 1},
+	{1, 24, 265, 1},
+	{44, 24, 267, 1},
+	{27, 25, 269, 3},
+	{44, 25, 273, 1},
+	{44, 2, 275, 1},
+	{28, 4, 277, 4},
+	{12, 4, 282, 11},
+	{12, 4, 294, 1},
+	{12, 4, 296, 1},
+	{44, 4, 298, 1},
+	{15, 5, 300, 3},
+	{12, 5, 304, 3},
+	{14, 5, 308, 0},
+	{44, 5, 309, 1},
+	{15, 6, 311, 3},
+	{12, 6, 315, 1},
+	{13, 6, 317, 1},
+	{44, 6, 319, 1},
+	{18, 7, 321, 3},
+	{12, 7, 325, 1},
+	{12, 7, 327, 1},
+	{44, 7, 329, 1},
+	{15, 8, 331, 3},
+	{12, 8, 335, 3},
+	{12, 8, 339, 3},
+	{7, 8, 343, 1},
+	{12, 8, 345, 1},
+	{44, 8, 347, 1},
+	{27, 9, 349, 3},
+	{44, 9, 353, 1},
+	{30, 10, 355, 6},
+	{12, 10, 362, 3},
+	{44, 10, 366, 1},
+	{27, 11, 368, 3},
+	{44, 11, 372, 1},
+};
+
+const Std_Function std_functions[] = {
+	{55, 9, 17, 1, 19, 13}, // __stdcube
+	{128, 8, 37, 2, 40, 25}, // __stdpow
+	{282, 11, 92, 2, 95, 23}, // __stdrepeat
+	{7, 11, 3, 1, 5, 7}, // __stdsquare
+	{221, 8, 70, 1, 72, 15}, // __stdsum
+};
+
+const size_t std_function_count = 5;
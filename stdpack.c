@@ -0,0 +1,211 @@
+// build tool, lexes the stdlib sources and writes their tokens out as std_blob.c so frosting
+// never has to read or lex them when it starts, it parses them as well but only to check them
+// usage: stdpack out.c file.pastry...
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "std.h"
+
+typedef struct {
+	char* data;
+	size_t size;
+	size_t capacity;
+} Pool;
+
+void pool_add(Pool* pool, char* str, size_t size){
+	while(pool->size+size+1 > pool->capacity){
+		pool->capacity *= 2;
+		pool->data = realloc(pool->data, pool->capacity);
+	}
+	memcpy(pool->data+pool->size, str, size);
+	pool->data[pool->size+size] = '\0';
+	pool->size += size+1;
+}
+
+char* read_source(char* path, size_t* size){
+	FILE* file = fopen(path, "r");
+	if(file == NULL){
+		fprintf(stderr, "[ERR] Failed to open %s\n", path);
+		return NULL;
+	}
+	fseek(file, 0, SEEK_END);
+	*size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	char* src = malloc(*size+1);
+	if(fread(src, sizeof(char), *size, file) != *size){
+		fprintf(stderr, "[ERR] Failed to read %s\n", path);
+		free(src);
+		fclose(file);
+		return NULL;
+	}
+	src[*size] = '\0';
+	fclose(file);
+	return src;
+}
+
+// the names get sorted the same way find_std_function searches them
+char* sort_strings = NULL;
+
+int compare_functions(const void* lhs, const void* rhs){
+	const Std_Function* a = lhs;
+	const Std_Function* b = rhs;
+	int order = memcmp(sort_strings+a->name, sort_strings+b->name, a->name_size < b->name_size ? a->name_size : b->name_size);
+	if(order != 0){
+		return order;
+	}
+	return (a->name_size > b->name_size) - (a->name_size < b->name_size);
+}
+
+void write_bytes(FILE* out, char* data, size_t size){
+	for(size_t i = 0; i < size; i++){
+		fprintf(out, "%s0x%02x,", i%16 == 0 ? "\n\t" : " ", (unsigned char)data[i]);
+	}
+}
+
+int main(int argc, char** argv){
+	if(argc < 2){
+		fprintf(stderr, "Usage: stdpack out.c [file.pastry...]\n");
+		return 1;
+	}
+	int exit_code = 0;
+	Pool strings = {
+		.data = malloc(1024),
+		.size = 0,
+		.capacity = 1024,
+	};
+	size_t token_count = 0;
+	size_t token_capacity = 256;
+	Std_Token* tokens = malloc(token_capacity*sizeof(Std_Token));
+	size_t function_count = 0;
+	size_t function_capacity = 16;
+	Std_Function* functions = malloc(function_capacity*sizeof(Std_Function));
+
+	for(int i = 2; i < argc && exit_code == 0; i++){
+		size_t size = 0;
+		char* src = read_source(argv[i], &size);
+		if(src == NULL){
+			exit_code = 1;
+			break;
+		}
+		Lexer lexer = lex(src, size);
+		Parser parser = {0};
+		if(lexer.exit_code != 0){
+			fprintf(stderr, "[ERR] %s failed to lex\n", argv[i]);
+			exit_code = 1;
+			goto next_file;
+		}
+		parser = parse(lexer);
+		if(parser.exit_code != 0){
+			fprintf(stderr, "[ERR] %s failed to parse\n", argv[i]);
+			exit_code = 1;
+			goto next_file;
+		}
+		if(parser.size != 0){
+			fprintf(stderr, "[ERR] %s has statements outside of functions, the stdlib can only define functions\n", argv[i]);
+			exit_code = 1;
+			goto next_file;
+		}
+
+		size_t base = token_count;
+		for(size_t j = 0; j < lexer.size; j++){
+			if(token_count >= token_capacity){
+				token_capacity *= 2;
+				tokens = realloc(tokens, token_capacity*sizeof(Std_Token));
+			}
+			tokens[token_count] = (Std_Token){
+				.type = lexer.tokens[j].type,
+				.line = lexer.tokens[j].line,
+				.str = strings.size,
+				.size = lexer.tokens[j].size,
+			};
+			pool_add(&strings, lexer.tokens[j].str, lexer.tokens[j].size);
+			token_count++;
+		}
+
+		for(size_t j = 0; j < parser.function_count; j++){
+			Function* function = &parser.functions[j];
+			// bodies are checked now so a broken stdlib fails the build instead of a script
+			if(parse_function(&parser, function) != 0){
+				fprintf(stderr, "[ERR] Function %.*s in %s has errors in its body\n", (int)function->name_size, function->name, argv[i]);
+				exit_code = 1;
+				goto next_file;
+			}
+			// the body comes right after the args and the newline ending them, the name before the args
+			size_t body = function->body-lexer.tokens;
+			size_t args = body-1-function->argc;
+			if(function_count >= function_capacity){
+				function_capacity *= 2;
+				functions = realloc(functions, function_capacity*sizeof(Std_Function));
+			}
+			functions[function_count] = (Std_Function){
+				.name = tokens[base+args-1].str,
+				.name_size = function->name_size,
+				.args = base+args,
+				.argc = function->argc,
+				.body = base+body,
+				.body_size = function->body_size,
+			};
+			function_count++;
+		}
+
+next_file:
+		if(parser.exprs != NULL){
+			free_parser(&parser);
+		}
+		free_lexer(&lexer);
+		free(src);
+	}
+
+	sort_strings = strings.data;
+	qsort(functions, function_count, sizeof(Std_Function), compare_functions);
+	for(size_t i = 1; i < function_count && exit_code == 0; i++){
+		if(compare_functions(&functions[i-1], &functions[i]) == 0){
+			fprintf(stderr, "[ERR] The stdlib defines %.*s more than once\n", (int)functions[i].name_size, strings.data+functions[i].name);
+			exit_code = 1;
+		}
+	}
+
+	FILE* out = NULL;
+	if(exit_code == 0){
+		out = fopen(argv[1], "w");
+		if(out == NULL){
+			fprintf(stderr, "[ERR] Failed to open %s for writing\n", argv[1]);
+			exit_code = 1;
+		}
+	}
+	if(out != NULL){
+		fprintf(out, "// generated by stdpack from the std/*.pastry sources, don't edit\n");
+		fprintf(out, "#include \"std.h\"\n\n");
+		fprintf(out, "const char std_strings[] = {");
+		write_bytes(out, strings.data, strings.size);
+		fprintf(out, "\n\t0x00,\n};\n\n");
+
+		// empty arrays aren't allowed, a lone zero entry is never looked at
+		fprintf(out, "const Std_Token std_tokens[] = {\n");
+		for(size_t i = 0; i < token_count; i++){
+			fprintf(out, "\t{%u, %u, %u, %u},\n", tokens[i].type, tokens[i].line, tokens[i].str, tokens[i].size);
+		}
+		if(token_count == 0){
+			fprintf(out, "\t{0, 0, 0, 0},\n");
+		}
+		fprintf(out, "};\n\n");
+		fprintf(out, "const Std_Function std_functions[] = {\n");
+		for(size_t i = 0; i < function_count; i++){
+			fprintf(out, "\t{%u, %u, %u, %u, %u, %u}, // %.*s\n", functions[i].name, functions[i].name_size, functions[i].args,
+				functions[i].argc, functions[i].body, functions[i].body_size, (int)functions[i].name_size, strings.data+functions[i].name);
+		}
+		if(function_count == 0){
+			fprintf(out, "\t{0, 0, 0, 0, 0, 0},\n");
+		}
+		fprintf(out, "};\n\n");
+		fprintf(out, "const size_t std_function_count = %zu;\n", function_count);
+		fclose(out);
+	}
+
+	free(strings.data);
+	free(tokens);
+	free(functions);
+	return exit_code;
+}
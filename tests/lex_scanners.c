@@ -0,0 +1,140 @@
+// lexes generated sources with every scanner the CPU has and checks they all find exactly the
+// tokens the scalar one does, runs are made 0 to 80 bytes long so they start and end on both
+// sides of the 16 and 32 byte chunks, and every source is also cut off at each length so
+// runs reach the end of the buffer (which is malloc'd to size so a sanitizer sees any overread)
+#include "../lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCES 1000
+#define MAX_PIECES 24
+#define MAX_RUN 80
+
+unsigned int seed = 12345;
+
+unsigned int next_random(unsigned int below){
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed % below;
+}
+
+const char* word_start = "abcxyzABCXYZ_";
+const char* word_rest = "abcxyzABCXYZ_0123456789";
+const char* spaces = " \t\r";
+// what goes inside comments and strings, bytes past 127 included, quotes only in comments
+const char* text = "ab 19_\t\"/=+{}\x80\xc3\xff";
+const char* operators[] = {"+", "-", "*", "/", ",", "(", ")", "<", ">", "<=", ">="};
+
+void add(char* out, size_t* size, char c){
+	out[*size] = c;
+	(*size)++;
+}
+
+// one piece of source, never more than MAX_RUN+4 bytes
+void add_piece(char* out, size_t* size){
+	size_t run = next_random(MAX_RUN+1);
+	switch(next_random(7)){
+		case 0:
+			add(out, size, word_start[next_random(strlen(word_start))]);
+			for(size_t i = 0; i < run; i++){
+				add(out, size, word_rest[next_random(strlen(word_rest))]);
+			}
+			break;
+		case 1:
+			for(size_t i = 0; i <= run; i++){
+				add(out, size, '0'+next_random(10));
+			}
+			break;
+		case 2:
+			for(size_t i = 0; i <= run; i++){
+				add(out, size, spaces[next_random(strlen(spaces))]);
+			}
+			break;
+		case 3:
+			add(out, size, '/');
+			add(out, size, '/');
+			for(size_t i = 0; i < run; i++){
+				add(out, size, text[next_random(strlen(text))]);
+			}
+			add(out, size, '\n');
+			break;
+		case 4:
+			add(out, size, '"');
+			for(size_t i = 0; i < run; i++){
+				char c = text[next_random(strlen(text))];
+				add(out, size, c == '"' ? '\n' : c);
+			}
+			add(out, size, '"');
+			break;
+		case 5:
+		{
+			const char* operator = operators[next_random(sizeof(operators)/sizeof(operators[0]))];
+			for(size_t i = 0; operator[i] != '\0'; i++){
+				add(out, size, operator[i]);
+			}
+			// so two of them never make a comment or a lone =, which only print errors
+			// (== is left out for the same reason, cutting the source can split it)
+			add(out, size, ' ');
+			break;
+		}
+		default:
+			add(out, size, '\n');
+			break;
+	}
+}
+
+int same_tokens(Lexer* a, Lexer* b){
+	if(a->size != b->size || a->exit_code != b->exit_code){
+		return 0;
+	}
+	for(size_t i = 0; i < a->size; i++){
+		Token* x = &a->tokens[i];
+		Token* y = &b->tokens[i];
+		if(x->type != y->type || x->size != y->size || x->line != y->line || memcmp(x->str, y->str, x->size) != 0){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+int main(void){
+	enum Lex_Scanner scanners[] = {LEX_SSE2, LEX_AVX2, LEX_BEST};
+	const char* names[] = {"sse2", "avx2", "best"};
+	char source[MAX_PIECES*(MAX_RUN+4)];
+	size_t checked = 0;
+	int failed = 0;
+	for(int s = 0; s < SOURCES && !failed; s++){
+		size_t size = 0;
+		size_t pieces = 1+next_random(MAX_PIECES);
+		for(size_t p = 0; p < pieces; p++){
+			add_piece(source, &size);
+		}
+		for(size_t cut = 0; cut <= size && !failed; cut++){
+			char* src = malloc(cut > 0 ? cut : 1);
+			memcpy(src, source, cut);
+			Lexer expected = lex_with(src, cut, LEX_SCALAR);
+			for(size_t k = 0; k < sizeof(scanners)/sizeof(scanners[0]); k++){
+				if(!lex_scanner_supported(scanners[k])){
+					continue;
+				}
+				Lexer got = lex_with(src, cut, scanners[k]);
+				if(!same_tokens(&expected, &got)){
+					printf("[FAIL] the %s scanner disagrees with the scalar one on source %d cut to %zu bytes:\n%.*s\n", names[k], s, cut, (int)cut, src);
+					failed = 1;
+				}
+				free_lexer(&got);
+				checked++;
+			}
+			free_lexer(&expected);
+			free(src);
+		}
+	}
+	if(!failed){
+		printf("lex_scanners: %zu lexes agreed (sse2 %s, avx2 %s)\n", checked,
+			lex_scanner_supported(LEX_SSE2) ? "checked" : "not built",
+			lex_scanner_supported(LEX_AVX2) ? "checked" : "not on this cpu");
+	}
+	return failed;
+}
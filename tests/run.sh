@@ -0,0 +1,39 @@
+#!/bin/sh
+# runs every tests/*.pastry through the interpreter and again with --jit, both have to print
+# exactly what its .out has (errors included, the trace left out)
+# a .in next to a test gets piped in with -n, and the flags in a .args get passed as well
+# a .trace next to a test keeps the trace lines in, for tests that are about the trace
+frosting=${1:-./frosting}
+# tests that need to run frosting more than once (like snapshot) run it as $FROSTING
+export FROSTING="$frosting"
+dir=$(dirname "$0")
+failed=0
+
+strip_trace(){
+	if [ -f "$name.trace" ]; then
+		cat
+	else
+		grep -v '^\[TRACE\]'
+	fi
+}
+
+for test in "$dir"/*.pastry; do
+	name=${test%.pastry}
+	args=""
+	if [ -f "$name.args" ]; then
+		args=$(cat "$name.args")
+	fi
+	for mode in "" --jit; do
+		if [ -f "$name.in" ]; then
+			got=$("$frosting" -n "$test" $mode $args < "$name.in" 2>&1 | strip_trace)
+		else
+			got=$("$frosting" "$test" $mode $args < /dev/null 2>&1 | strip_trace)
+		fi
+		if [ "$got" != "$(cat "$name.out")" ]; then
+			echo "[FAIL] $test $mode"
+			echo "$got" | diff "$name.out" - | head -20
+			failed=1
+		fi
+	done
+done
+exit $failed
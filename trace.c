@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200809L
+#include "trace.h"
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+// always on, a statement costs one slot write and a short copy
+Trace_Entry trace_ring[TRACE_ENTRIES];
+size_t trace_count = 0;
+int trace_dumped = 0;
+int trace_held = 0;
+
+// same order as the keywords in enum TokenType
+const char* trace_names[] = {
+	"var", "print", "read", "for", "while", "if", "else", "elif", "and", "or", "not",
+	"exit", "end", "func", "call", "return", "sh", "spawn", "wait", "load", "each", "write",
+	"pfor", "snapshot", "map", "put", "get", "has", "delete",
+};
+
+void trace_signal(int signal){
+	(void)signal;
+	trace_dump(2);
+}
+
+void trace_start(void){
+	trace_count = 0;
+	trace_dumped = 0;
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = trace_signal;
+	sigemptyset(&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &action, NULL);
+}
+
+Trace_Entry* trace_statement(uint32_t line, enum TokenType type, Token* first){
+	Trace_Entry* entry = &trace_ring[trace_count & (TRACE_ENTRIES-1)];
+	trace_count++;
+	entry->line = line;
+	entry->type = type;
+	entry->summary_size = 0;
+	if(first != NULL){
+		size_t size = first->size < TRACE_SUMMARY_SIZE ? first->size : TRACE_SUMMARY_SIZE;
+		memcpy(entry->summary, first->str, size);
+		entry->summary_size = size;
+	}
+	return entry;
+}
+
+void trace_value(Trace_Entry* entry, char* str, size_t size){
+	size_t used = entry->summary_size;
+	if(used >= TRACE_SUMMARY_SIZE){
+		return;
+	}
+	entry->summary[used] = '=';
+	used++;
+	size_t room = TRACE_SUMMARY_SIZE-used;
+	if(size > room){
+		size = room;
+	}
+	memcpy(entry->summary+used, str, size);
+	entry->summary_size = used+size;
+}
+
+// printf isn't safe in a signal handler, so numbers get formatted by hand
+size_t trace_format_number(char* out, size_t value){
+	char digits[24];
+	size_t count = 0;
+	do{
+		digits[count] = '0'+(value%10);
+		value /= 10;
+		count++;
+	}while(value > 0);
+	for(size_t i = 0; i < count; i++){
+		out[i] = digits[count-1-i];
+	}
+	return count;
+}
+
+size_t trace_append(char* out, size_t used, const char* str, size_t size){
+	memcpy(out+used, str, size);
+	return used+size;
+}
+
+void trace_dump(int fd){
+	// read once, the program may still be running when this comes from SIGUSR1
+	size_t count = trace_count;
+	size_t first = count > TRACE_ENTRIES ? count-TRACE_ENTRIES : 0;
+	char line[128];
+	size_t used = trace_append(line, 0, "[TRACE] last ", 13);
+	used += trace_format_number(line+used, count-first);
+	used = trace_append(line, used, " of ", 4);
+	used += trace_format_number(line+used, count);
+	used = trace_append(line, used, " statements, newest last\n", 25);
+	if(write(fd, line, used) < 0){
+		return;
+	}
+
+	for(size_t i = first; i < count; i++){
+		Trace_Entry* entry = &trace_ring[i & (TRACE_ENTRIES-1)];
+		used = trace_append(line, 0, "[TRACE] line ", 13);
+		used += trace_format_number(line+used, entry->line);
+		line[used] = ' ';
+		used++;
+		if(entry->type >= VAR && entry->type < NEWLINE){
+			const char* name = trace_names[entry->type-VAR];
+			used = trace_append(line, used, name, strlen(name));
+		}
+		else{
+			used += trace_format_number(line+used, entry->type);
+		}
+		if(entry->summary_size > 0){
+			line[used] = ' ';
+			used++;
+			for(size_t c = 0; c < entry->summary_size && c < TRACE_SUMMARY_SIZE; c++){
+				char ch = entry->summary[c];
+				// values can have newlines and escapes in them, keep each entry on one line
+				line[used] = (ch < ' ' || ch == 127) ? '.' : ch;
+				used++;
+			}
+		}
+		line[used] = '\n';
+		used++;
+		if(write(fd, line, used) < 0){
+			return;
+		}
+	}
+}
+
+void trace_hold(int held){
+	trace_held = held;
+}
+
+void trace_error(void){
+	if(trace_dumped || trace_held){
+		return;
+	}
+	trace_dumped = 1;
+	trace_dump(2);
+}
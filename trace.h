@@ -0,0 +1,32 @@
+#ifndef TRACE_H
+#define TRACE_H
+#include <stddef.h>
+#include <stdint.h>
+#include "lexer.h"
+
+// has to stay a power of two, the ring wraps with a mask
+#define TRACE_ENTRIES 256
+#define TRACE_SUMMARY_SIZE 24
+
+// one statement that ran, kept small so recording it is just a few stores
+typedef struct {
+	uint32_t line;
+	uint8_t type;
+	uint8_t summary_size;
+	char summary[TRACE_SUMMARY_SIZE];
+} Trace_Entry;
+
+// empties the ring and hooks SIGUSR1 up to dump it
+void trace_start(void);
+// takes the next slot in the ring, first is the statement's first arg (NULL if it isn't a literal)
+Trace_Entry* trace_statement(uint32_t line, enum TokenType type, Token* first);
+// adds `=value` onto the summary, cut short if it doesn't fit
+void trace_value(Trace_Entry* entry, char* str, size_t size);
+// writes the ring oldest first, only uses write() so the signal handler can call it
+void trace_dump(int fd);
+// dumps to stderr the first time something goes wrong in a run
+void trace_error(void);
+// while held errors don't dump, pfor iterations run on other threads and the ring isn't theirs
+void trace_hold(int held);
+
+#endif // TRACE_H